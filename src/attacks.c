@@ -17,9 +17,6 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
-#ifdef USE_PEXT
-#include <immintrin.h>
-#endif
 
 #include "attacks.h"
 #include "bits.h"
@@ -56,14 +53,60 @@ BitBoard PINNED_MOVES[64][64];
 
 BitBoard PAWN_ATTACKS[2][64];
 BitBoard KNIGHT_ATTACKS[64];
-BitBoard BISHOP_ATTACKS[64][512];
-BitBoard ROOK_ATTACKS[64][4096];
 BitBoard KING_ATTACKS[64];
-BitBoard ROOK_MASKS[64];
-BitBoard BISHOP_MASKS[64];
 
-uint64_t ROOK_MAGICS[64];
-uint64_t BISHOP_MAGICS[64];
+// Fancy magics: every square owns a slice of one shared table, sized by its
+// relevant bits instead of the worst case. Footprint of the slider lookups:
+//
+//   previous [64][512] + [64][4096] tables  2304 KiB (L3 resident)
+//   packed bishop slices (5248 entries)       41 KiB (~L1d)
+//   packed rook slices (102400 entries)      800 KiB (L2 on 1+ MiB L2 parts)
+//   Magic structs, 2 x 64 x 32 bytes           4 KiB (L1d)
+//
+// PEXT builds index the same packed slices with _pext_u64 and never read the
+// multiplier, so both modes touch the same 845 KiB
+BitBoard SLIDER_ATTACKS[SLIDER_TABLE_SIZE];
+
+Magic BISHOP_MAGICS[64];
+Magic ROOK_MAGICS[64];
+
+// Found with FindMagicNumber after SeedRandom(0), precomputed so startup
+// no longer has to search for them
+const uint64_t BISHOP_MAGIC_NUMBERS[64] = {
+    0x0020828081010200ULL, 0x4020410421004045ULL, 0x4084080081030428ULL, 0x2002208200400040ULL,
+    0x40240504102d0220ULL, 0x000a081424100200ULL, 0x0004108410080200ULL, 0x4040808050108400ULL,
+    0x2004420822041042ULL, 0x0006101000890054ULL, 0x06085010c0810800ULL, 0x08000444008a080cULL,
+    0x000a0d1041001000ULL, 0x1040008220600200ULL, 0x0010110110100400ULL, 0x00000830880c1040ULL,
+    0x8840400510041108ULL, 0x0502000818510400ULL, 0x02411008080b0010ULL, 0x800406084400080eULL,
+    0x4801004590400190ULL, 0x8101000080603200ULL, 0x0301110044100400ULL, 0x004020208a080200ULL,
+    0x010844180aa01800ULL, 0x0904204004588880ULL, 0x1218510908020400ULL, 0x9008080040202120ULL,
+    0x0120840202802000ULL, 0x5118024004806020ULL, 0x0942088684040120ULL, 0x0009010190440891ULL,
+    0x3041101021882010ULL, 0x1000822040080801ULL, 0x0410280800010a00ULL, 0xc020400808038200ULL,
+    0x0204200200402080ULL, 0x8090004200134100ULL, 0x8110010304204460ULL, 0x4021086200018a00ULL,
+    0xc10808a208a01000ULL, 0x0024308818048410ULL, 0x4002010448004101ULL, 0x0402012011008802ULL,
+    0x0000102012000041ULL, 0x00a1014101004200ULL, 0x0002820424008108ULL, 0xa210010069010880ULL,
+    0x0800421011082208ULL, 0x8000804842102000ULL, 0x0400050088040015ULL, 0x0001020084043004ULL,
+    0x02250c4010410040ULL, 0x200c910210010000ULL, 0x0a12029004108000ULL, 0x8028c84284014009ULL,
+    0x00053c0200a2e000ULL, 0x1060102401080822ULL, 0x800404420082210dULL, 0x0100708002050412ULL,
+    0x1100404240105100ULL, 0x08202120081042c0ULL, 0x0600204801082480ULL, 0x0a02a00202021220ULL};
+
+const uint64_t ROOK_MAGIC_NUMBERS[64] = {
+    0x80800015c0082080ULL, 0x00c0100140002000ULL, 0x0100104009042000ULL, 0x0480080080100004ULL,
+    0x1080040008008002ULL, 0x1200080410020001ULL, 0x030004ca00040500ULL, 0x408000a480004900ULL,
+    0x0422800024904000ULL, 0x6000400050002001ULL, 0x1221002005021240ULL, 0x0000808008001000ULL,
+    0x2050808004000800ULL, 0x0042000200080410ULL, 0x1004000241084410ULL, 0x080200040484690aULL,
+    0x81c0808000284004ULL, 0x09c0018020008040ULL, 0x4000420020801200ULL, 0x4008008010000882ULL,
+    0x8038008004008008ULL, 0x0802808002000400ULL, 0x0c10440021020890ULL, 0x0000020000840041ULL,
+    0x0080005040002001ULL, 0x0000400480200080ULL, 0x0000104100200101ULL, 0x0010001080800800ULL,
+    0x0000040080800800ULL, 0x2048020080040080ULL, 0x0880120400810850ULL, 0x028809020004884cULL,
+    0x2440102040800086ULL, 0x1020100020404000ULL, 0x0861200184801000ULL, 0x0200801000800800ULL,
+    0x0010080080800400ULL, 0x2202001002000409ULL, 0x04401022040008a1ULL, 0x0802049106000054ULL,
+    0x0040804000228000ULL, 0x0050004020014010ULL, 0x2020200010008080ULL, 0x0010008100080800ULL,
+    0x0028000400088080ULL, 0x4112010488020010ULL, 0x0462000408020001ULL, 0x10400ca841020004ULL,
+    0x8006320146810200ULL, 0x0000812000400280ULL, 0x0010144020090100ULL, 0x008a001008452200ULL,
+    0x0018004004020040ULL, 0x0020020004008080ULL, 0x0006011002080400ULL, 0x0000024700b40200ULL,
+    0x0000410080002011ULL, 0x040811042182c001ULL, 0x58201041000a2001ULL, 0x0c00041001210009ULL,
+    0x000200846010182aULL, 0x0001000208040013ULL, 0x9005000082002441ULL, 0x0484802102c40186ULL};
 
 void InitBetweenSquares() {
   int i;
@@ -247,11 +290,6 @@ BitBoard GetBishopMask(int sq) {
   return attacks;
 }
 
-void InitBishopMasks() {
-  for (int i = 0; i < 64; i++)
-    BISHOP_MASKS[i] = GetBishopMask(i);
-}
-
 BitBoard GetBishopAttacksOTF(int sq, BitBoard blockers) {
   BitBoard attacks = 0;
 
@@ -303,11 +341,6 @@ BitBoard GetRookMask(int sq) {
   return attacks;
 }
 
-void InitRookMasks() {
-  for (int i = 0; i < 64; i++)
-    ROOK_MASKS[i] = GetRookMask(i);
-}
-
 BitBoard GetRookAttacksOTF(int sq, BitBoard blockers) {
   BitBoard attacks = 0;
 
@@ -361,7 +394,7 @@ uint64_t FindMagicNumber(int sq, int n, int isBishop) {
   BitBoard attacks[4096];
   BitBoard usedAttacks[4096];
 
-  BitBoard mask = isBishop ? BISHOP_MASKS[sq] : ROOK_MASKS[sq];
+  BitBoard mask = isBishop ? GetBishopMask(sq) : GetRookMask(sq);
 
   for (int i = 0; i < numOccupancies; i++) {
     occupancies[i] = SetPieceLayoutOccupancy(i, n, mask);
@@ -394,52 +427,29 @@ uint64_t FindMagicNumber(int sq, int n, int isBishop) {
   return 0;
 }
 
-void InitBishopMagics() {
-  for (int i = 0; i < 64; i++)
-    BISHOP_MAGICS[i] = FindMagicNumber(i, BISHOP_RELEVANT_BITS[i], 1);
-}
-
-void InitRookMagics() {
-  for (int i = 0; i < 64; i++)
-    ROOK_MAGICS[i] = FindMagicNumber(i, ROOK_RELEVANT_BITS[i], 0);
-}
-
-void InitBishopAttacks() {
+// Lay out each square's slice after the previous one and fill it, walking
+// every subset of the mask with the Carry-Rippler trick
+static BitBoard* InitSliderAttacks(BitBoard* table, int isBishop) {
   for (int sq = 0; sq < 64; sq++) {
-    BitBoard mask = BISHOP_MASKS[sq];
-    int bits      = BISHOP_RELEVANT_BITS[sq];
-    int n         = (1 << bits);
-
-    for (int i = 0; i < n; i++) {
-      BitBoard occupancy = SetPieceLayoutOccupancy(i, bits, mask);
-
-#ifndef USE_PEXT
-      int idx                 = (occupancy * BISHOP_MAGICS[sq]) >> (64 - bits);
-      BISHOP_ATTACKS[sq][idx] = GetBishopAttacksOTF(sq, occupancy);
-#else
-      BISHOP_ATTACKS[sq][_pext_u64(occupancy, mask)] = GetBishopAttacksOTF(sq, occupancy);
-#endif
-    }
+    Magic* m = isBishop ? &BISHOP_MAGICS[sq] : &ROOK_MAGICS[sq];
+    int bits = isBishop ? BISHOP_RELEVANT_BITS[sq] : ROOK_RELEVANT_BITS[sq];
+
+    m->attacks = table;
+    m->mask    = isBishop ? GetBishopMask(sq) : GetRookMask(sq);
+    m->magic   = isBishop ? BISHOP_MAGIC_NUMBERS[sq] : ROOK_MAGIC_NUMBERS[sq];
+    m->shift   = 64 - bits;
+
+    BitBoard occupancy = 0;
+    do {
+      m->attacks[MagicIndex(m, occupancy)] =
+        isBishop ? GetBishopAttacksOTF(sq, occupancy) : GetRookAttacksOTF(sq, occupancy);
+      occupancy = (occupancy - m->mask) & m->mask;
+    } while (occupancy);
+
+    table += 1 << bits;
   }
-}
 
-void InitRookAttacks() {
-  for (int sq = 0; sq < 64; sq++) {
-    BitBoard mask = ROOK_MASKS[sq];
-    int bits      = ROOK_RELEVANT_BITS[sq];
-    int n         = (1 << bits);
-
-    for (int i = 0; i < n; i++) {
-      BitBoard occupancy = SetPieceLayoutOccupancy(i, bits, mask);
-
-#ifndef USE_PEXT
-      int idx               = (occupancy * ROOK_MAGICS[sq]) >> (64 - bits);
-      ROOK_ATTACKS[sq][idx] = GetRookAttacksOTF(sq, occupancy);
-#else
-      ROOK_ATTACKS[sq][_pext_u64(occupancy, mask)]   = GetRookAttacksOTF(sq, occupancy);
-#endif
-    }
-  }
+  return table;
 }
 
 void InitAttacks() {
@@ -450,16 +460,8 @@ void InitAttacks() {
   InitKnightAttacks();
   InitKingAttacks();
 
-  InitBishopMasks();
-  InitRookMasks();
-
-#ifndef USE_PEXT
-  InitBishopMagics();
-  InitRookMagics();
-#endif
-
-  InitBishopAttacks();
-  InitRookAttacks();
+  BitBoard* rookTable = InitSliderAttacks(SLIDER_ATTACKS, 1);
+  InitSliderAttacks(rookTable, 0);
 }
 
 inline BitBoard GetPawnAttacks(int sq, int color) {
@@ -471,27 +473,13 @@ inline BitBoard GetKnightAttacks(int sq) {
 }
 
 inline BitBoard GetBishopAttacks(int sq, BitBoard occupancy) {
-#ifndef USE_PEXT
-  occupancy &= BISHOP_MASKS[sq];
-  occupancy *= BISHOP_MAGICS[sq];
-  occupancy >>= 64 - BISHOP_RELEVANT_BITS[sq];
-
-  return BISHOP_ATTACKS[sq][occupancy];
-#else
-  return BISHOP_ATTACKS[sq][_pext_u64(occupancy, BISHOP_MASKS[sq])];
-#endif
+  const Magic* m = &BISHOP_MAGICS[sq];
+  return m->attacks[MagicIndex(m, occupancy)];
 }
 
 inline BitBoard GetRookAttacks(int sq, BitBoard occupancy) {
-#ifndef USE_PEXT
-  occupancy &= ROOK_MASKS[sq];
-  occupancy *= ROOK_MAGICS[sq];
-  occupancy >>= 64 - ROOK_RELEVANT_BITS[sq];
-
-  return ROOK_ATTACKS[sq][occupancy];
-#else
-  return ROOK_ATTACKS[sq][_pext_u64(occupancy, ROOK_MASKS[sq])];
-#endif
+  const Magic* m = &ROOK_MAGICS[sq];
+  return m->attacks[MagicIndex(m, occupancy)];
 }
 
 inline BitBoard GetQueenAttacks(int sq, BitBoard occupancy) {
@@ -17,33 +17,42 @@
 #ifndef ATTACKS_H
 #define ATTACKS_H
 
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
 #include "types.h"
+#include "util.h"
+
+// 5248 bishop + 102400 rook entries
+#define SLIDER_TABLE_SIZE 107648
+
+typedef struct {
+  BitBoard* attacks;
+  BitBoard mask;
+  uint64_t magic;
+  int shift;
+} Magic;
 
 extern BitBoard BETWEEN_SQS[64][64];
 extern BitBoard PINNED_MOVES[64][64];
 
 extern BitBoard PAWN_ATTACKS[2][64];
 extern BitBoard KNIGHT_ATTACKS[64];
-extern BitBoard BISHOP_ATTACKS[64][512];
-extern BitBoard ROOK_ATTACKS[64][4096];
 extern BitBoard KING_ATTACKS[64];
-extern BitBoard ROOK_MASKS[64];
-extern BitBoard BISHOP_MASKS[64];
+extern BitBoard SLIDER_ATTACKS[SLIDER_TABLE_SIZE];
 
-extern uint64_t ROOK_MAGICS[64];
-extern uint64_t BISHOP_MAGICS[64];
+extern Magic BISHOP_MAGICS[64];
+extern Magic ROOK_MAGICS[64];
+
+extern const uint64_t BISHOP_MAGIC_NUMBERS[64];
+extern const uint64_t ROOK_MAGIC_NUMBERS[64];
 
 void InitBetweenSquares();
 void InitPinnedMovementSquares();
 void initPawnSpans();
 void InitPawnAttacks();
 void InitKnightAttacks();
-void InitBishopMasks();
-void InitBishopMagics();
-void InitBishopAttacks();
-void InitRookMasks();
-void InitRookMagics();
-void InitRookAttacks();
 void InitKingAttacks();
 void InitAttacks();
 
@@ -58,6 +67,14 @@ BitBoard SetPieceLayoutOccupancy(int idx, int bits, BitBoard attacks);
 
 uint64_t FindMagicNumber(int sq, int n, int bishop);
 
+INLINE int MagicIndex(const Magic* m, BitBoard occupancy) {
+#ifndef USE_PEXT
+  return ((occupancy & m->mask) * m->magic) >> m->shift;
+#else
+  return _pext_u64(occupancy, m->mask);
+#endif
+}
+
 BitBoard BetweenSquares(int from, int to);
 BitBoard PinnedMoves(int p, int k);
 
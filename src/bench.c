@@ -17,13 +17,27 @@
 #include "bench.h"
 
 #include <limits.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "board.h"
 #include "move.h"
+#include "movegen.h"
+#include "movepick.h"
+#include "nn/accumulator.h"
+#include "nn/evaluate.h"
 #include "search.h"
+#include "see.h"
+#include "stats.h"
 #include "thread.h"
 #include "transposition.h"
 #include "types.h"
@@ -39,23 +53,21 @@ char* benchmarks[]            = {
 void Bench(int depth) {
   Board board;
 
-  Limits.depth   = depth;
-  Limits.multiPV = 1;
-  Limits.hitrate = INT_MAX;
-  Limits.max     = INT_MAX;
-  Limits.timeset = 0;
+  SetSearchLimits(depth, 0, 0, 1);
 
   Move bestMoves[NUM_BENCH_POSITIONS];
   int scores[NUM_BENCH_POSITIONS];
   uint64_t nodes[NUM_BENCH_POSITIONS];
   long times[NUM_BENCH_POSITIONS];
 
+  StatsClear();
+
   long startTime = GetTimeMS();
   for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
     ParseFen(benchmarks[i], &board);
 
-    TTClear();
     SearchClear();
+    TTClear();
 
     Limits.start = GetTimeMS();
     StartSearch(&board, 0);
@@ -84,4 +96,869 @@ void Bench(int depth) {
     totalNodes += nodes[i];
 
   printf("\nResults: %43" PRIu64 " nodes %8d nps\n\n", totalNodes, (int) (1000.0 * totalNodes / (totalTime + 1)));
-}
\ No newline at end of file
+
+#if defined(STATS)
+  StatsPrint();
+#endif
+}
+
+// Copies the FEN part of an EPD line (the first 4 fields, and the move
+// counters when they are there) into fen, returning 0 if there is none or it
+// doesn't look like one
+static int EPDToFen(char* line, char* fen) {
+  char fields[6][64];
+  int n = sscanf(line, "%63s %63s %63s %63s %63s %63s", fields[0], fields[1], fields[2], fields[3], fields[4], fields[5]);
+  if (n < 4)
+    return 0;
+
+  int ranks = 1;
+  for (char* c = fields[0]; *c; c++)
+    ranks += *c == '/';
+
+  if (ranks != 8 || (strcmp(fields[1], "w") && strcmp(fields[1], "b")))
+    return 0;
+
+  int length;
+  if (n == 6 && strspn(fields[4], "0123456789") == strlen(fields[4]) &&
+      strspn(fields[5], "0123456789") == strlen(fields[5]))
+    length = snprintf(fen, 128, "%s %s %s %s %s %s", fields[0], fields[1], fields[2], fields[3], fields[4], fields[5]);
+  else
+    length = snprintf(fen, 128, "%s %s %s %s 0 1", fields[0], fields[1], fields[2], fields[3]);
+
+  return length < 128;
+}
+
+// Reads the FEN of each EPD line into fens, returning how many it read
+static int ReadPositions(char* path, char (*fens)[128], int max) {
+  FILE* fin = fopen(path, "r");
+  if (fin == NULL)
+    return 0;
+
+  int count = 0;
+  char line[1024];
+  while (count < max && fgets(line, sizeof(line), fin))
+    count += EPDToFen(line, fens[count]);
+
+  fclose(fin);
+  return count;
+}
+
+// Two sided 95% t values for 1..30 degrees of freedom, normal beyond
+static double T95(int df) {
+  static const double T[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+
+  return df < 1 ? 0 : df <= 30 ? T[df - 1] : 1.960;
+}
+
+// "bench" with options, e.g. "bench file x.epd threads 4 hash 256 nodes 1000000 repeat 5".
+// Searches with a depth, movetime and/or node limit and prints the runs as JSON
+void BenchSuite(char* args) {
+  char* file   = NULL;
+  int depth    = 0;
+  int threads  = Threads.count;
+  int hash     = TT.size / MEGABYTE;
+  int moveTime = 0;
+  int repeat   = 1;
+  int multiPV  = 1;
+  uint64_t nodeLimit = 0;
+
+  for (char* key = strtok(args, " \n"); key; key = strtok(NULL, " \n")) {
+    char* value = strtok(NULL, " \n");
+    if (!value)
+      break;
+
+    if (!strcmp(key, "file"))
+      file = value;
+    else if (!strcmp(key, "depth"))
+      depth = Max(1, Min(MAX_SEARCH_PLY - 1, atoi(value)));
+    else if (!strcmp(key, "threads"))
+      threads = Max(1, Min(256, atoi(value)));
+    else if (!strcmp(key, "hash"))
+      hash = Max(2, atoi(value));
+    else if (!strcmp(key, "movetime"))
+      moveTime = Max(1, atoi(value));
+    else if (!strcmp(key, "nodes"))
+      nodeLimit = strtoull(value, NULL, 10);
+    else if (!strcmp(key, "repeat"))
+      repeat = Max(1, atoi(value));
+    else if (!strcmp(key, "multipv"))
+      multiPV = Max(1, Min(256, atoi(value)));
+  }
+
+  if (!depth && !moveTime && !nodeLimit)
+    depth = DEFAULT_BENCH_DEPTH;
+
+  int count;
+  char(*fens)[128] = malloc(sizeof(*fens) * MAX_BENCH_POSITIONS);
+  if (file) {
+    count = ReadPositions(file, fens, MAX_BENCH_POSITIONS);
+    if (!count) {
+      printf("info string Unable to read positions from %s\n", file);
+      free(fens);
+      return;
+    }
+  } else {
+    count = NUM_BENCH_POSITIONS;
+    for (int i = 0; i < count; i++)
+      snprintf(fens[i], 128, "%s", benchmarks[i]);
+  }
+
+  const int oldThreads = Threads.count;
+  const int oldHash    = TT.size / MEGABYTE;
+  if (threads != oldThreads)
+    ThreadsSetNumber(threads);
+  if (hash != oldHash)
+    TTInit(hash);
+
+  SetSearchLimits(depth, nodeLimit, moveTime, multiPV);
+  Limits.quiet = 1;
+
+  Board board;
+  double* nps = malloc(sizeof(double) * repeat);
+
+  printf("{\n  \"engine\": \"Berserk %s\",\n", VERSION);
+  printf("  \"config\": {\"file\": \"%s\", \"positions\": %d, \"threads\": %d, \"hash\": %d, ",
+         file ? file : "bench",
+         count,
+         threads,
+         hash);
+  printf("\"depth\": %d, \"movetime\": %d, \"nodes\": %" PRIu64 ", \"repeat\": %d, \"multipv\": %d},\n",
+         depth,
+         moveTime,
+         nodeLimit,
+         repeat,
+         multiPV);
+  printf("  \"runs\": [\n");
+
+  for (int r = 0; r < repeat; r++) {
+    uint64_t totalNodes = 0;
+    long totalTime      = 0;
+
+    printf("    {\"positions\": [\n");
+    for (int i = 0; i < count; i++) {
+      ParseFen(fens[i], &board);
+
+      SearchClear();
+      TTClear();
+
+      Limits.start = GetTimeMS();
+      StartSearch(&board, 0);
+      ThreadWaitUntilSleep(Threads.threads[0]);
+
+      long time      = GetTimeMS() - Limits.start;
+      uint64_t nodes = NodesSearched();
+      totalNodes += nodes;
+      totalTime += time;
+
+      printf("      {\"fen\": \"%s\", \"nodes\": %" PRIu64 ", \"time\": %ld, \"nps\": %" PRIu64
+             ", \"depth\": %d, \"bestmove\": \"%s\"}%s\n",
+             fens[i],
+             nodes,
+             time,
+             (uint64_t) (1000.0 * nodes / Max(1, time)),
+             Threads.threads[0]->completedDepth,
+             MoveToStr(Threads.threads[0]->rootMoves[0].move, &board),
+             i + 1 < count ? "," : "");
+    }
+
+    nps[r] = 1000.0 * totalNodes / Max(1, totalTime);
+    printf("    ], \"nodes\": %" PRIu64 ", \"time\": %ld, \"nps\": %.0f}%s\n",
+           totalNodes,
+           totalTime,
+           nps[r],
+           r + 1 < repeat ? "," : "");
+  }
+
+  double mean = 0, variance = 0;
+  for (int r = 0; r < repeat; r++)
+    mean += nps[r] / repeat;
+  for (int r = 0; r < repeat; r++)
+    variance += (nps[r] - mean) * (nps[r] - mean) / Max(1, repeat - 1);
+
+  const double stddev = sqrt(variance);
+  const double margin = T95(repeat - 1) * stddev / sqrt(repeat);
+
+  printf("  ],\n");
+  printf("  \"nps\": {\"mean\": %.0f, \"stddev\": %.0f, \"ci95\": [%.0f, %.0f]}\n}\n",
+         mean,
+         stddev,
+         mean - margin,
+         mean + margin);
+
+  Limits.nodes = 0;
+  Limits.quiet = 0;
+  if (threads != oldThreads)
+    ThreadsSetNumber(oldThreads);
+  if (hash != oldHash)
+    TTInit(oldHash);
+
+  free(nps);
+  free(fens);
+}
+
+// Search the bench positions back to back without clearing the hash so
+// the table fills up, then measure how often the layout reports false hits
+void TTBench(int depth) {
+  Board board;
+
+  SetSearchLimits(depth, 0, 0, 1);
+
+  SearchClear();
+  TTClear();
+
+  uint64_t totalNodes = 0;
+  long startTime      = GetTimeMS();
+  for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+    ParseFen(benchmarks[i], &board);
+
+    Limits.start = GetTimeMS();
+    StartSearch(&board, 0);
+    ThreadWaitUntilSleep(Threads.threads[0]);
+
+    totalNodes += NodesSearched();
+  }
+  long totalTime = GetTimeMS() - startTime;
+
+  printf("\nTT Layout: %s\n", TTLayout());
+  printf("Results: %41" PRIu64 " nodes %8d nps\n", totalNodes, (int) (1000.0 * totalNodes / (totalTime + 1)));
+  printf("Hashfull: %40d permill\n", TTFull());
+  printf("False hits: %38.2f per million probes\n\n", 1000000.0 * TTFalseHitRate(1000000));
+}
+
+// Time to depth and the share of unique nodes (positions stored in the TT per
+// node searched) for 1, 2, 4, ... up to maxThreads threads. The hash should be
+// big enough to not overflow, or the unique count is an underestimate.
+// With a depth, the speedup is the time to depth against one thread. With a
+// node budget it is the depth reached that moves instead, and the times only
+// give the nps scaling
+void SMPBench(int depth, uint64_t nodes, int maxThreads) {
+  Board board;
+
+  SetSearchLimits(nodes ? 0 : depth, nodes, 0, 1);
+
+  const int originalThreads = Threads.count;
+  long baseTime             = 0;
+  double baseNps            = 0;
+
+  printf("\nHelper policy: %s, %s %" PRIu64 "\n",
+         HelperPolicyName(),
+         nodes ? "nodes" : "depth",
+         nodes ? nodes : (uint64_t) depth);
+  for (int threads = 1;; threads = Min(maxThreads, 2 * threads)) {
+    ThreadsSetNumber(threads);
+
+    Threads.setupTime = Threads.joinTime = Threads.voteTime = Threads.allAwakeTime = 0;
+    atomic_store(&Threads.wakeTime, 0);
+
+    uint64_t totalNodes = 0, uniqueNodes = 0;
+    long totalTime      = 0;
+    int totalDepth      = 0;
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+      ParseFen(benchmarks[i], &board);
+
+      SearchClear();
+      TTClear();
+
+      Limits.start = GetTimeMS();
+      StartSearch(&board, 0);
+      ThreadWaitUntilSleep(Threads.threads[0]);
+      totalTime += GetTimeMS() - Limits.start;
+
+      totalNodes += NodesSearched();
+      uniqueNodes += TTStored();
+      totalDepth += Threads.threads[0]->completedDepth;
+    }
+
+    const double nps = 1000.0 * totalNodes / (totalTime + 1);
+    if (threads == 1)
+      baseTime = totalTime, baseNps = nps;
+
+    printf("Threads %3d: %8ld ms %12" PRIu64 " nodes %9d nps %5.2fx nps scaling %6.2f%% unique",
+           threads,
+           totalTime,
+           totalNodes,
+           (int) nps,
+           nps / Max(1, baseNps),
+           100.0 * uniqueNodes / Max(1, totalNodes));
+    if (nodes)
+      printf(" %5.2f depth", (double) totalDepth / NUM_BENCH_POSITIONS);
+    else
+      printf(" %5.2fx speedup", (double) baseTime / Max(1, totalTime));
+
+    // Per search averages, the helpers' wake up is from the start of the go,
+    // to the average helper starting and to all of them searching
+    printf(" | us setup %5" PRIu64 " wake %6" PRIu64 " all %6" PRIu64 " join %5" PRIu64 " vote %4" PRIu64 "\n",
+           Threads.setupTime / NUM_BENCH_POSITIONS,
+           LoadRlx(Threads.wakeTime) / Max(1, (threads - 1) * NUM_BENCH_POSITIONS),
+           Threads.allAwakeTime / NUM_BENCH_POSITIONS,
+           Threads.joinTime / NUM_BENCH_POSITIONS,
+           Threads.voteTime / NUM_BENCH_POSITIONS);
+
+    if (threads == maxThreads)
+      break;
+  }
+  printf("\n");
+
+  Limits.nodes = 0;
+
+  ThreadsSetNumber(originalThreads);
+}
+
+#if defined(__linux__)
+// User space only hardware counter for this process and any thread it
+// creates afterwards, or -1 when perf events aren't available
+static int PerfOpen(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size           = sizeof(attr);
+  attr.type           = type;
+  attr.config         = config;
+  attr.inherit        = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+
+  return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t PerfRead(int fd) {
+  uint64_t value = 0;
+  if (fd < 0)
+    return 0;
+
+  if (read(fd, &value, sizeof(value)) != sizeof(value))
+    value = 0;
+
+  close(fd);
+  return value;
+}
+#endif
+
+// Search the bench positions and report NPS, cache misses per node and the
+// share of last level cache accesses that still miss, for the continuation
+// history layout and child prefetches this binary was built with
+void HistoryBench(int depth) {
+  Board board;
+
+  SetSearchLimits(depth, 0, 0, 1);
+
+  const int threads = Threads.count;
+
+#if defined(__linux__)
+  int llcMisses = PerfOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  int llcRefs   = PerfOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+  int stalls    = PerfOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND);
+  int l1dMisses = PerfOpen(PERF_TYPE_HW_CACHE,
+                           PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+  // Counters are only inherited by threads created after they are opened
+  ThreadsSetNumber(0);
+  ThreadsSetNumber(threads);
+#endif
+
+  uint64_t totalNodes = 0;
+  long startTime      = GetTimeMS();
+  for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+    ParseFen(benchmarks[i], &board);
+
+    SearchClear();
+    TTClear();
+
+    Limits.start = GetTimeMS();
+    StartSearch(&board, 0);
+    ThreadWaitUntilSleep(Threads.threads[0]);
+
+    totalNodes += NodesSearched();
+  }
+  long totalTime = GetTimeMS() - startTime;
+
+  printf("\nHistory layout: %s (%" PRIu64 " KB continuation history per thread)\n",
+         CH_ROWS == 12 ? "full" : "compact",
+         (uint64_t) sizeof(Threads.threads[0]->ch) / 1024);
+#if defined(NO_PREFETCH)
+  printf("Child prefetch: tt\n");
+#else
+  printf("Child prefetch: tt, eval cache, input weights\n");
+#endif
+  printf("Results: %41" PRIu64 " nodes %8d nps\n", totalNodes, (int) (1000.0 * totalNodes / (totalTime + 1)));
+
+#if defined(__linux__)
+  // Exiting threads fold their counts into the ones read here
+  ThreadsSetNumber(0);
+  ThreadsSetNumber(threads);
+
+  const uint64_t llc  = PerfRead(llcMisses);
+  const uint64_t refs = PerfRead(llcRefs);
+  const uint64_t back = PerfRead(stalls);
+  const uint64_t l1d  = PerfRead(l1dMisses);
+  if (llcMisses >= 0 && l1dMisses >= 0) {
+    printf("LLC misses: %39.2f per node\n", (double) llc / Max(1, totalNodes));
+    if (llcRefs >= 0)
+      printf("LLC miss rate: %35.2f%%\n", 100.0 * llc / Max(1, refs));
+    printf("L1D misses: %39.2f per node\n", (double) l1d / Max(1, totalNodes));
+    if (stalls >= 0)
+      printf("Backend stalls: %34.2f cycles per node\n", (double) back / Max(1, totalNodes));
+    printf("\n");
+    return;
+  }
+#endif
+
+  printf("Cache misses: unavailable\n\n");
+}
+
+// Runs the bench positions with each move ordering, counting how many scored
+// moves the picker never got to (only in STATS builds)
+void MovePickBench(int depth) {
+  Board board;
+
+  SetSearchLimits(depth, 0, 0, 1);
+
+  const int partialSort = PARTIAL_SORT;
+
+  printf("\n");
+  for (PARTIAL_SORT = 0; PARTIAL_SORT <= 1; PARTIAL_SORT++) {
+    StatsClear();
+
+    uint64_t totalNodes = 0;
+    long startTime      = GetTimeMS();
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+      ParseFen(benchmarks[i], &board);
+
+      SearchClear();
+      TTClear();
+
+      Limits.start = GetTimeMS();
+      StartSearch(&board, 0);
+      ThreadWaitUntilSleep(Threads.threads[0]);
+
+      totalNodes += NodesSearched();
+    }
+    long totalTime = GetTimeMS() - startTime;
+
+    printf("%-9s %12" PRIu64 " nodes %9d nps",
+           PARTIAL_SORT ? "Partial:" : "Select:",
+           totalNodes,
+           (int) (1000.0 * totalNodes / (totalTime + 1)));
+
+#if defined(STATS)
+    uint64_t scored = 0, picked = 0;
+    for (int i = 0; i < Threads.count; i++) {
+      scored += Threads.threads[i]->stats.mpScored;
+      picked += Threads.threads[i]->stats.mpPicked;
+    }
+
+    printf(" %6.2f scored %6.2f never picked per node",
+           (double) scored / Max(1, totalNodes),
+           (double) (scored - picked) / Max(1, totalNodes));
+#endif
+    printf("\n");
+  }
+  printf("\n");
+
+  PARTIAL_SORT = partialSort;
+}
+
+// Times each move generation hot path on its own over the bench positions,
+// without any search or network work, in ns per call
+void MoveGenBench(int iterations) {
+  Board* boards            = malloc(sizeof(Board) * NUM_BENCH_POSITIONS);
+  SimpleMoveList* pseudo   = malloc(sizeof(SimpleMoveList) * NUM_BENCH_POSITIONS);
+  SimpleMoveList* legal    = malloc(sizeof(SimpleMoveList) * NUM_BENCH_POSITIONS);
+  ScoredMove moves[MAX_MOVES];
+
+  uint64_t pseudoCount = 0, legalCount = 0, noisyCount = 0;
+  for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+    ParseFen(benchmarks[i], &boards[i]);
+
+    ScoredMove* end = AddNoisyMoves(moves, &boards[i]);
+    noisyCount += end - moves;
+    end = AddQuietMoves(end, &boards[i]);
+
+    pseudo[i].count = end - moves;
+    for (int j = 0; j < pseudo[i].count; j++)
+      pseudo[i].moves[j] = moves[j].move;
+
+    end            = AddPerftMoves(moves, &boards[i]);
+    legal[i].count = end - moves;
+    for (int j = 0; j < legal[i].count; j++)
+      legal[i].moves[j] = moves[j].move;
+
+    pseudoCount += pseudo[i].count;
+    legalCount += legal[i].count;
+  }
+
+  // Accumulated results, printed so no work is optimized away
+  uint64_t check = 0;
+  long time;
+
+  printf("\n%d iterations over %d positions\n\n", iterations, NUM_BENCH_POSITIONS);
+
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++)
+      check += AddQuietMoves(AddNoisyMoves(moves, &boards[i]), &boards[i]) - moves;
+  time = GetTimeMS() - time;
+  printf("%-14s %10.1f ns/position %8.2f ns/move\n",
+         "Generate:",
+         1e6 * time / ((double) iterations * NUM_BENCH_POSITIONS),
+         1e6 * time / ((double) iterations * pseudoCount));
+
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++)
+      check += AddPerftMoves(moves, &boards[i]) - moves;
+  time = GetTimeMS() - time;
+  printf("%-14s %10.1f ns/position %8.2f ns/move\n",
+         "Legal gen:",
+         1e6 * time / ((double) iterations * NUM_BENCH_POSITIONS),
+         1e6 * time / ((double) iterations * legalCount));
+
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++)
+      for (int j = 0; j < pseudo[i].count; j++)
+        check += IsLegal(pseudo[i].moves[j], &boards[i]);
+  time = GetTimeMS() - time;
+  printf("%-14s %10.2f ns/move\n", "IsLegal:", 1e6 * time / ((double) iterations * pseudoCount));
+
+  // Moves from the next position stand in for hash moves and killers, a mix
+  // of pseudo legal and not
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+      SimpleMoveList* other = &pseudo[(i + 1) % NUM_BENCH_POSITIONS];
+      for (int j = 0; j < other->count; j++)
+        check += IsPseudoLegal(other->moves[j], &boards[i]);
+    }
+  time = GetTimeMS() - time;
+  printf("%-14s %10.2f ns/move\n", "IsPseudoLegal:", 1e6 * time / ((double) iterations * pseudoCount));
+
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++)
+      for (int j = 0; j < legal[i].count; j++) {
+        MakeMoveUpdate(legal[i].moves[j], &boards[i], 0);
+        check += boards[i].zobrist;
+        UndoMove(legal[i].moves[j], &boards[i]);
+      }
+  time = GetTimeMS() - time;
+  printf("%-14s %10.2f ns/move\n", "Make/undo:", 1e6 * time / ((double) iterations * legalCount));
+
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++)
+      for (int j = 0; j < pseudo[i].count; j++)
+        check += SEE(&boards[i], pseudo[i].moves[j], 0);
+  time = GetTimeMS() - time;
+  printf("%-14s %10.2f ns/move (%.1f%% noisy)\n",
+         "SEE:",
+         1e6 * time / ((double) iterations * pseudoCount),
+         100.0 * noisyCount / pseudoCount);
+
+  printf("\nChecksum: %" PRIu64 "\n\n", check);
+
+  free(boards);
+  free(pseudo);
+  free(legal);
+}
+
+// Times SEE on every noisy move of the bench positions, one move at a time
+// and as a batch per position, in ns per move. The thresholds are the good
+// capture cutoffs the picker uses with an empty capture history.
+void SEEBench(int iterations) {
+  Board* boards     = malloc(sizeof(Board) * NUM_BENCH_POSITIONS);
+  ScoredMove* noisy = malloc(sizeof(ScoredMove) * MAX_MOVES * NUM_BENCH_POSITIONS);
+  int* thresholds   = malloc(sizeof(int) * MAX_MOVES * NUM_BENCH_POSITIONS);
+  int* counts       = malloc(sizeof(int) * NUM_BENCH_POSITIONS);
+  int results[MAX_MOVES];
+
+  uint64_t noisyCount = 0, squareCount = 0;
+  for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+    ParseFen(benchmarks[i], &boards[i]);
+
+    ScoredMove* moves = noisy + i * MAX_MOVES;
+    counts[i]         = AddNoisyMoves(moves, &boards[i]) - moves;
+
+    BitBoard targets = 0;
+    for (int j = 0; j < counts[i]; j++) {
+      thresholds[i * MAX_MOVES + j] = -SEE_VALUE[PieceType(boards[i].squares[To(moves[j].move)])] / 2;
+      SetBit(targets, To(moves[j].move));
+    }
+
+    noisyCount += counts[i];
+    squareCount += BitCount(targets);
+  }
+
+  // Both have to agree
+  for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+    ScoredMove* moves = noisy + i * MAX_MOVES;
+    SEEBatch(&boards[i], moves, moves + counts[i], thresholds + i * MAX_MOVES, results);
+
+    for (int j = 0; j < counts[i]; j++)
+      if (results[j] != SEE(&boards[i], moves[j].move, thresholds[i * MAX_MOVES + j]))
+        printf("Mismatch on %s for %s\n", benchmarks[i], MoveToStr(moves[j].move, &boards[i]));
+  }
+
+  // Accumulated results, printed so no work is optimized away
+  uint64_t check = 0;
+  long time;
+
+  printf("\n%d iterations over %" PRIu64 " noisy moves to %" PRIu64 " squares in %d positions\n\n",
+         iterations,
+         noisyCount,
+         squareCount,
+         NUM_BENCH_POSITIONS);
+
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++)
+      for (int j = 0; j < counts[i]; j++)
+        check += SEE(&boards[i], noisy[i * MAX_MOVES + j].move, thresholds[i * MAX_MOVES + j]);
+  time = GetTimeMS() - time;
+  printf("%-14s %8.2f ns/move\n", "SEE:", 1e6 * time / ((double) iterations * noisyCount));
+
+  time = GetTimeMS();
+  for (int n = 0; n < iterations; n++)
+    for (int i = 0; i < NUM_BENCH_POSITIONS; i++) {
+      ScoredMove* moves = noisy + i * MAX_MOVES;
+      SEEBatch(&boards[i], moves, moves + counts[i], thresholds + i * MAX_MOVES, results);
+      for (int j = 0; j < counts[i]; j++)
+        check += results[j];
+    }
+  time = GetTimeMS() - time;
+  printf("%-14s %8.2f ns/move\n", "SEEBatch:", 1e6 * time / ((double) iterations * noisyCount));
+
+  printf("\nChecksum: %" PRIu64 "\n\n", check);
+
+  free(boards);
+  free(noisy);
+  free(thresholds);
+  free(counts);
+}
+
+INLINE void EvalBatchFlush(Board* boards, char (*fens)[128], int n) {
+  int scores[EVAL_BATCH_SIZE];
+  PredictBatch(boards, n, scores);
+
+  for (int i = 0; i < n; i++)
+    printf("%s | %d\n", fens[i], scores[i]);
+}
+
+// Score every FEN (or EPD line) of a file with the raw network output from
+// the side to move's point of view, printing "<fen> | <score>"
+void EvalBatch(char* path) {
+  FILE* fin = fopen(path, "r");
+  if (fin == NULL) {
+    printf("info string Unable to read file at %s\n", path);
+    return;
+  }
+
+  Board* boards                      = malloc(sizeof(Board) * EVAL_BATCH_SIZE);
+  char(*fens)[128]                   = malloc(sizeof(*fens) * EVAL_BATCH_SIZE);
+  Accumulator* accumulators          = AlignedMalloc(sizeof(Accumulator) * EVAL_BATCH_SIZE, 64);
+  AccumulatorKingState* refreshTable = AlignedMalloc(sizeof(AccumulatorKingState) * 2 * 2 * N_KING_BUCKETS, 64);
+  ResetRefreshTable(&NETWORK, refreshTable);
+
+  char line[1024];
+  int n          = 0;
+  uint64_t total = 0;
+  long startTime = GetTimeMS();
+
+  int skipped = 0;
+  while (fgets(line, sizeof(line), fin)) {
+    if (!EPDToFen(line, fens[n])) {
+      skipped += line[strspn(line, " \t\r\n")] != '\0';
+      continue;
+    }
+
+    ParseFen(fens[n], &boards[n]);
+    boards[n].accumulators = &accumulators[n];
+    boards[n].refreshTable = refreshTable;
+
+    if (++n == EVAL_BATCH_SIZE) {
+      EvalBatchFlush(boards, fens, n);
+      total += n, n = 0;
+    }
+  }
+
+  if (n)
+    EvalBatchFlush(boards, fens, n);
+  total += n;
+
+  long totalTime = GetTimeMS() - startTime;
+  printf("info string Evaluated %" PRIu64 " positions in %ldms (%d per second)\n",
+         total,
+         totalTime,
+         (int) (1000.0 * total / (totalTime + 1)));
+  if (skipped)
+    printf("info string Skipped %d lines without a FEN\n", skipped);
+
+  fclose(fin);
+  free(boards);
+  free(fens);
+  AlignedFree(accumulators);
+  AlignedFree(refreshTable);
+}
+
+// Positions read ahead of the search by the analyze reader thread
+#define ANALYZE_QUEUE_SIZE 1024
+
+typedef struct {
+  FILE* fin;
+  char fens[ANALYZE_QUEUE_SIZE][128];
+  int head, tail, done;
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+} AnalyzeQueue;
+
+static void* AnalyzeReader(void* arg) {
+  AnalyzeQueue* q = arg;
+  char line[1024], fen[128];
+
+  while (fgets(line, sizeof(line), q->fin)) {
+    if (!EPDToFen(line, fen))
+      continue;
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->tail - q->head == ANALYZE_QUEUE_SIZE)
+      pthread_cond_wait(&q->changed, &q->mutex);
+
+    memcpy(q->fens[q->tail++ % ANALYZE_QUEUE_SIZE], fen, sizeof(fen));
+    pthread_cond_signal(&q->changed);
+    pthread_mutex_unlock(&q->mutex);
+  }
+
+  pthread_mutex_lock(&q->mutex);
+  q->done = 1;
+  pthread_cond_signal(&q->changed);
+  pthread_mutex_unlock(&q->mutex);
+
+  return NULL;
+}
+
+static int AnalyzeNext(AnalyzeQueue* q, char* fen) {
+  pthread_mutex_lock(&q->mutex);
+  while (q->head == q->tail && !q->done)
+    pthread_cond_wait(&q->changed, &q->mutex);
+
+  int found = q->head != q->tail;
+  if (found) {
+    memcpy(fen, q->fens[q->head++ % ANALYZE_QUEUE_SIZE], 128);
+    pthread_cond_signal(&q->changed);
+  }
+
+  pthread_mutex_unlock(&q->mutex);
+  return found;
+}
+
+// "analyze <file> [depth n] [nodes n] [movetime n] [clear]" searches every EPD
+// position in a file, streaming "<fen> | <bestmove> | <score> | <depth> | <nodes>".
+// Reading is done ahead by another thread and each result is written while the
+// next position is searched. The TT and histories are kept between positions
+// (which is what makes related positions cheap) unless "clear" is given.
+void Analyze(char* args) {
+  char* file = strtok(args, " \n");
+  int depth = 0, moveTime = 0, clear = 0;
+  uint64_t nodeLimit = 0;
+
+  for (char* key = strtok(NULL, " \n"); key; key = strtok(NULL, " \n")) {
+    if (!strcmp(key, "clear")) {
+      clear = 1;
+      continue;
+    }
+
+    char* value = strtok(NULL, " \n");
+    if (!value)
+      break;
+
+    if (!strcmp(key, "depth"))
+      depth = Max(1, Min(MAX_SEARCH_PLY - 1, atoi(value)));
+    else if (!strcmp(key, "movetime"))
+      moveTime = Max(1, atoi(value));
+    else if (!strcmp(key, "nodes"))
+      nodeLimit = strtoull(value, NULL, 10);
+  }
+
+  if (!depth && !moveTime && !nodeLimit)
+    depth = DEFAULT_ANALYZE_DEPTH;
+
+  AnalyzeQueue* q = calloc(1, sizeof(AnalyzeQueue));
+  q->fin          = file ? fopen(file, "r") : NULL;
+  if (!q->fin) {
+    printf("info string Unable to read file at %s\n", file ? file : "");
+    free(q);
+    return;
+  }
+
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->changed, NULL);
+
+  pthread_t reader;
+  pthread_create(&reader, NULL, AnalyzeReader, q);
+
+  SetSearchLimits(depth, nodeLimit, moveTime, 1);
+  Limits.quiet = 1;
+
+  Board board;
+  char fen[128], result[256] = "";
+  uint64_t total = 0, totalNodes = 0;
+  long startTime = GetTimeMS();
+
+  while (AnalyzeNext(q, fen)) {
+    ParseFen(fen, &board);
+
+    if (clear) {
+      SearchClear();
+      TTClear();
+    }
+
+    Limits.start = GetTimeMS();
+    StartSearch(&board, 0);
+
+    // the previous position's result goes out while this one is searched
+    if (*result)
+      fputs(result, stdout);
+
+    ThreadWaitUntilSleep(Threads.threads[0]);
+
+    ThreadData* thread = Threads.threads[0];
+    RootMove* best     = &thread->rootMoves[0];
+    uint64_t nodes     = NodesSearched();
+    int score          = best->score;
+
+    totalNodes += nodes, total++;
+    snprintf(result,
+             sizeof(result),
+             "%s | %s | %s %d | %d | %" PRIu64 "\n",
+             fen,
+             thread->numRootMoves ? MoveToStr(best->move, &board) : "0000",
+             abs(score) > MATE_BOUND ? "mate" : "cp",
+             score > MATE_BOUND    ? (CHECKMATE - score + 1) / 2 :
+             score < -MATE_BOUND   ? -(CHECKMATE + score) / 2 :
+             abs(score) > TB_WIN_BOUND ? score :
+                                         (int) Normalize(score),
+             thread->completedDepth,
+             nodes);
+  }
+
+  if (*result)
+    fputs(result, stdout);
+
+  long totalTime = GetTimeMS() - startTime;
+  printf("info string Analyzed %" PRIu64 " positions (%" PRIu64 " nodes) in %ldms (%.1f per second)\n",
+         total,
+         totalNodes,
+         totalTime,
+         1000.0 * total / Max(1, totalTime));
+
+  Limits.nodes = 0;
+  Limits.quiet = 0;
+
+  pthread_join(reader, NULL);
+  pthread_mutex_destroy(&q->mutex);
+  pthread_cond_destroy(&q->changed);
+  fclose(q->fin);
+  free(q);
+}
@@ -17,8 +17,21 @@
 #ifndef BENCH_H
 #define BENCH_H
 
+#include <stdint.h>
+
 #define DEFAULT_BENCH_DEPTH 13
+#define MAX_BENCH_POSITIONS 4096
+#define DEFAULT_ANALYZE_DEPTH 10
 
 void Bench(int depth);
+void BenchSuite(char* args);
+void TTBench(int depth);
+void SMPBench(int depth, uint64_t nodes, int maxThreads);
+void HistoryBench(int depth);
+void MovePickBench(int depth);
+void MoveGenBench(int iterations);
+void SEEBench(int iterations);
+void EvalBatch(char* path);
+void Analyze(char* args);
 
 #endif
\ No newline at end of file
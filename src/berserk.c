@@ -14,6 +14,7 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include <ctype.h>
 #include <string.h>
 
 #include "attacks.h"
@@ -21,6 +22,7 @@
 #include "bits.h"
 #include "eval.h"
 #include "nn/evaluate.h"
+#include "numa.h"
 #include "random.h"
 #include "search.h"
 #include "thread.h"
@@ -31,24 +33,44 @@
 #include "zobrist.h"
 
 // Welcome to berserk
+#if defined(FAT_MAIN)
+__attribute__((visibility("default"))) int FAT_MAIN(int argc, char** argv) {
+#else
 int main(int argc, char** argv) {
+#endif
+  if (argc > 1 && !strcmp(argv[1], "--startup-profile")) {
+    STARTUP_PROFILE = 1;
+    argc--, argv++;
+  }
+
+  uint64_t start = GetTimeUS();
+
   SeedRandom(0);
 
-  InitZobristKeys();
-  InitPruningAndReductionTables();
-  InitAttacks();
-  InitCuckoo();
+  StartupPhase("zobrist", InitZobristKeys());
+  StartupPhase("reductions", InitPruningAndReductionTables());
+  StartupPhase("attacks", InitAttacks());
+  StartupPhase("cuckoo", InitCuckoo());
+  StartupPhase("numa", NumaInit());
+  StartupPhase("threads", ThreadsInit());
 
-  LoadDefaultNN();
-  ThreadsInit();
-  TTInit(16);
+  // The network and hash follow with the first command needing them
+  PrintStartupPhase("total", start);
 
   // Compliance for OpenBench
-  if (argc > 1 && !strncmp(argv[1], "bench", 5)) {
+  if (argc > 2 && !strncmp(argv[1], "bench", 5) && !isdigit(argv[2][0])) {
+    char args[4096] = "";
+    for (int i = 2; i < argc; i++)
+      snprintf(args + strlen(args), sizeof(args) - strlen(args), "%s ", argv[i]);
+
+    FinishStartup();
+    BenchSuite(args);
+  } else if (argc > 1 && !strncmp(argv[1], "bench", 5)) {
     int depth = DEFAULT_BENCH_DEPTH;
     if (argc > 2)
       depth = Max(1, atoi(argv[2]));
 
+    FinishStartup();
     Bench(depth);
   } else {
     UCILoop();
@@ -41,10 +41,14 @@ const uint16_t KING_BUCKETS[64] = {15, 15, 14, 14, 14, 14, 15, 15, //
                                    7,  6,  5,  4,  4,  5,  6,  7,  //
                                    3,  2,  1,  0,  0,  1,  2,  3};
 
+// Make/undo copy the start of Board into and out of BoardHistory
+_Static_assert(offsetof(BoardHistory, capture) == offsetof(Board, stm), "BoardHistory must mirror the start of Board");
+
 // reset the board to an empty state
 void ClearBoard(Board* board) {
   memset(board->pieces, 0, sizeof(board->pieces));
   memset(board->occupancies, 0, sizeof(board->occupancies));
+  memset(board->keys, 0, sizeof(board->keys));
   memset(board->history, 0, sizeof(board->history));
 
   for (int i = 0; i < 64; i++)
@@ -153,7 +157,9 @@ void ParseFen(char* fen, Board* board) {
   while (*fen && *fen != ' ')
     fen++;
 
-  sscanf(fen, " %d %d", &board->fmr, &board->moveNo);
+  int fmr = 0;
+  sscanf(fen, " %d %d", &fmr, &board->moveNo);
+  board->fmr = fmr;
 
   OccBB(WHITE) = OccBB(BLACK) = OccBB(BOTH) = 0;
   for (int i = WHITE_PAWN; i <= BLACK_KING; i++)
@@ -243,9 +249,8 @@ void PrintBoard(Board* board) {
 
 // Special pieces are those giving check, and those that are pinned
 // these must be recalculated every move for faster move legality purposes
-inline void SetSpecialPieces(Board* board) {
-  const int stm  = board->stm;
-  const int xstm = board->xstm;
+INLINE void SetSpecialPiecesColor(Board* board, const int stm) {
+  const int xstm = stm ^ 1;
 
   int kingSq = LSB(PieceBB(KING, stm));
 
@@ -266,10 +271,9 @@ inline void SetSpecialPieces(Board* board) {
   }
 }
 
-inline void SetThreats(Board* board) {
-  // Invert these to be confusing.
-  const int stm  = board->xstm;
-  const int xstm = board->stm;
+// stm here is the side threatening, the one that just moved
+INLINE void SetThreatsColor(Board* board, const int stm) {
+  const int xstm = stm ^ 1;
 
   // Take the enemy king off for through threats.
   BitBoard occ = OccBB(BOTH) ^ PieceBB(KING, xstm);
@@ -297,35 +301,51 @@ inline void SetThreats(Board* board) {
     board->threatenedBy[ROOK] |= GetRookAttacks(PopLSB(&rooks), occ);
   board->threatened |= board->threatenedBy[ROOK];
 
-  board->threatenedBy[QUEEN] = 0;
-  BitBoard queens            = PieceBB(QUEEN, stm);
+  BitBoard queens = PieceBB(QUEEN, stm);
   while (queens)
-    board->threatenedBy[QUEEN] |= GetQueenAttacks(PopLSB(&queens), occ);
-  board->threatened |= board->threatenedBy[QUEEN];
+    board->threatened |= GetQueenAttacks(PopLSB(&queens), occ);
+
+  board->threatened |= GetKingAttacks(LSB(PieceBB(KING, stm)));
+  board->threatsReady = 1;
+}
 
-  board->threatenedBy[KING] = GetKingAttacks(LSB(PieceBB(KING, stm)));
-  board->threatened |= board->threatenedBy[KING];
+void SetSpecialPieces(Board* board) {
+  if (board->stm == WHITE)
+    SetSpecialPiecesColor(board, WHITE);
+  else
+    SetSpecialPiecesColor(board, BLACK);
+}
+
+void SetThreats(Board* board) {
+  if (board->stm == WHITE)
+    SetThreatsColor(board, BLACK);
+  else
+    SetThreatsColor(board, WHITE);
 }
 
 void MakeMove(Move move, Board* board) {
   MakeMoveUpdate(move, board, 1);
 }
 
-void MakeMoveUpdate(Move move, Board* board, int update) {
+// Instantiated once per side to move, so that stm is a constant throughout
+INLINE void MakeMoveColor(Move move, Board* board, int update, const int stm) {
+  const int xstm = stm ^ 1;
+
   int from     = From(move);
   int to       = To(move);
   int piece    = Moving(move);
-  int captured = IsEP(move) ? Piece(PAWN, board->xstm) : board->squares[to];
+  int captured = IsEP(move) ? Piece(PAWN, xstm) : board->squares[to];
 
   // store hard to recalculate values
   memcpy(&board->history[board->histPly], board, offsetof(Board, stm));
   board->history[board->histPly].capture = captured;
+  board->keys[board->histPly]            = board->zobrist;
 
   board->fmr++;
   board->nullply++;
 
   FlipBits(board->pieces[piece], from, to);
-  FlipBits(OccBB(board->stm), from, to);
+  FlipBits(OccBB(stm), from, to);
   FlipBits(OccBB(BOTH), from, to);
 
   board->squares[from] = NO_PIECE;
@@ -338,10 +358,10 @@ void MakeMoveUpdate(Move move, Board* board, int update) {
   if (IsCas(move)) {
     int rookFrom = board->cr[CASTLING_ROOK[to]];
     int rookTo   = CASTLE_ROOK_DEST[to];
-    int rook     = Piece(ROOK, board->stm);
+    int rook     = Piece(ROOK, stm);
 
-    FlipBits(PieceBB(ROOK, board->stm), rookFrom, rookTo);
-    FlipBits(OccBB(board->stm), rookFrom, rookTo);
+    FlipBits(PieceBB(ROOK, stm), rookFrom, rookTo);
+    FlipBits(OccBB(stm), rookFrom, rookTo);
     FlipBits(OccBB(BOTH), rookFrom, rookTo);
 
     // chess960 can have the king going where the rook started
@@ -352,12 +372,12 @@ void MakeMoveUpdate(Move move, Board* board, int update) {
 
     board->zobrist ^= ZOBRIST_PIECES[rook][rookFrom] ^ ZOBRIST_PIECES[rook][rookTo];
   } else if (IsCap(move)) {
-    int capSq = IsEP(move) ? to - PawnDir(board->stm) : to;
+    int capSq = IsEP(move) ? to - PawnDir(stm) : to;
     if (IsEP(move))
       board->squares[capSq] = NO_PIECE;
 
     FlipBit(board->pieces[captured], capSq);
-    FlipBit(OccBB(board->xstm), capSq);
+    FlipBit(OccBB(xstm), capSq);
     FlipBit(OccBB(BOTH), capSq);
 
     board->zobrist ^= ZOBRIST_PIECES[captured][capSq];
@@ -382,14 +402,14 @@ void MakeMoveUpdate(Move move, Board* board, int update) {
 
   if (PieceType(piece) == PAWN) {
     if ((from ^ to) == 16) {
-      int epSquare = to - PawnDir(board->stm);
+      int epSquare = to - PawnDir(stm);
 
-      if (GetPawnAttacks(epSquare, board->stm) & PieceBB(PAWN, board->xstm)) {
+      if (GetPawnAttacks(epSquare, stm) & PieceBB(PAWN, xstm)) {
         board->epSquare = epSquare;
         board->zobrist ^= ZOBRIST_EP_KEYS[board->epSquare];
       }
     } else if (IsPromo(move)) {
-      int promoted = PromoPiece(move, board->stm);
+      int promoted = PromoPiece(move, stm);
       FlipBit(board->pieces[piece], to);
       FlipBit(board->pieces[promoted], to);
 
@@ -405,42 +425,59 @@ void MakeMoveUpdate(Move move, Board* board, int update) {
   }
 
   board->histPly++;
-  board->moveNo += (board->stm == BLACK);
-  board->xstm = board->stm;
-  board->stm ^= 1;
+  board->moveNo += (stm == BLACK);
+  board->xstm = stm;
+  board->stm  = xstm;
   board->zobrist ^= ZOBRIST_SIDE_KEY;
   board->pawnZobrist ^= ZOBRIST_SIDE_KEY;
 
   // special pieces must be loaded after the stm has changed
-  // this is because the new stm to move will be the one in check
-  SetSpecialPieces(board);
-  SetThreats(board);
+  // this is because the new stm to move will be the one in check.
+  // threats wait to be asked for, many nodes never need them
+  SetSpecialPiecesColor(board, xstm);
+  board->threatsReady = 0;
 
   if (update) {
-    board->accumulators->move     = move;
-    board->accumulators->captured = captured;
+    board->accumulators->move          = move;
+    board->accumulators->captured      = captured;
+    board->smallAccumulators->move     = move;
+    board->smallAccumulators->captured = captured;
 
     board->accumulators++;
     board->accumulators->correct[WHITE] = board->accumulators->correct[BLACK] = 0;
+    board->smallAccumulators++;
+    board->smallAccumulators->correct[WHITE] = board->smallAccumulators->correct[BLACK] = 0;
   }
 }
 
-void UndoMove(Move move, Board* board) {
+void MakeMoveUpdate(Move move, Board* board, int update) {
+  if (board->stm == WHITE)
+    MakeMoveColor(move, board, update, WHITE);
+  else
+    MakeMoveColor(move, board, update, BLACK);
+}
+
+// stm is the side that made the move being undone
+INLINE void UndoMoveColor(Move move, Board* board, const int stm) {
+  const int xstm = stm ^ 1;
+
   int from  = From(move);
   int to    = To(move);
   int piece = Moving(move);
 
-  board->stm = board->xstm;
-  board->xstm ^= 1;
+  board->stm  = stm;
+  board->xstm = xstm;
   board->histPly--;
-  board->moveNo -= (board->stm == BLACK);
+  board->moveNo -= (stm == BLACK);
   board->accumulators--;
+  board->smallAccumulators--;
 
   // reload historical values
   memcpy(board, &board->history[board->histPly], offsetof(Board, stm));
+  board->zobrist = board->keys[board->histPly];
 
   if (IsPromo(move)) {
-    int promoted = PromoPiece(move, board->stm);
+    int promoted = PromoPiece(move, stm);
     FlipBit(board->pieces[piece], to);
     FlipBit(board->pieces[promoted], to);
     board->squares[to] = piece;
@@ -449,7 +486,7 @@ void UndoMove(Move move, Board* board) {
   }
 
   FlipBits(board->pieces[piece], to, from);
-  FlipBits(OccBB(board->stm), to, from);
+  FlipBits(OccBB(stm), to, from);
   FlipBits(OccBB(BOTH), to, from);
 
   board->squares[to]   = NO_PIECE;
@@ -458,21 +495,21 @@ void UndoMove(Move move, Board* board) {
   if (IsCas(move)) {
     int rookFrom = board->cr[CASTLING_ROOK[to]];
     int rookTo   = CASTLE_ROOK_DEST[to];
-    int rook     = Piece(ROOK, board->stm);
+    int rook     = Piece(ROOK, stm);
 
-    FlipBits(PieceBB(ROOK, board->stm), rookTo, rookFrom);
-    FlipBits(OccBB(board->stm), rookTo, rookFrom);
+    FlipBits(PieceBB(ROOK, stm), rookTo, rookFrom);
+    FlipBits(OccBB(stm), rookTo, rookFrom);
     FlipBits(OccBB(BOTH), rookTo, rookFrom);
 
     if (from != rookTo)
       board->squares[rookTo] = NO_PIECE;
     board->squares[rookFrom] = rook;
   } else if (IsCap(move)) {
-    int capSq    = IsEP(move) ? to - PawnDir(board->stm) : to;
+    int capSq    = IsEP(move) ? to - PawnDir(stm) : to;
     int captured = board->history[board->histPly].capture;
 
     FlipBit(board->pieces[captured], capSq);
-    FlipBit(OccBB(board->xstm), capSq);
+    FlipBit(OccBB(xstm), capSq);
     FlipBit(OccBB(BOTH), capSq);
 
     board->squares[capSq] = captured;
@@ -482,8 +519,16 @@ void UndoMove(Move move, Board* board) {
   }
 }
 
+void UndoMove(Move move, Board* board) {
+  if (board->xstm == WHITE)
+    UndoMoveColor(move, board, WHITE);
+  else
+    UndoMoveColor(move, board, BLACK);
+}
+
 void MakeNullMove(Board* board) {
   memcpy(&board->history[board->histPly], board, offsetof(Board, stm));
+  board->keys[board->histPly] = board->zobrist;
 
   board->fmr++;
   board->nullply = 0;
@@ -500,7 +545,7 @@ void MakeNullMove(Board* board) {
   board->xstm ^= 1;
 
   SetSpecialPieces(board);
-  SetThreats(board);
+  board->threatsReady = 0;
 }
 
 void UndoNullMove(Board* board) {
@@ -510,6 +555,7 @@ void UndoNullMove(Board* board) {
 
   // reload historical values
   memcpy(board, &board->history[board->histPly], offsetof(Board, stm));
+  board->zobrist = board->keys[board->histPly];
 }
 
 inline int IsDraw(Board* board, int ply) {
@@ -521,7 +567,7 @@ inline int IsRepetition(Board* board, int ply) {
 
   // Check as far back as the last non-reversible move
   for (int i = board->histPly - 4; i >= 0 && i >= board->histPly - distance; i -= 2) {
-    if (board->history[i].zobrist == board->zobrist) {
+    if (board->keys[i] == board->zobrist) {
       if (i > board->histPly - ply) // within our search tree
         return 1;
 
@@ -593,7 +639,7 @@ int IsPseudoLegal(Move move, Board* board) {
 
     if ((OccBB(BOTH) ^ Bit(from) ^ Bit(board->cr[idx])) & between)
       return 0;
-    if (kingCrossing & board->threatened)
+    if (kingCrossing & Threatened(board))
       return 0;
 
     return 1;
@@ -620,7 +666,7 @@ int IsPseudoLegal(Move move, Board* board) {
     return 0;
   if (GetBit(OccBB(board->stm), to))
     return 0;
-  if (pcType == KING && GetBit(board->threatened, to))
+  if (pcType == KING && GetBit(Threatened(board), to))
     return 0;
 
   if (pcType == PAWN) {
@@ -735,14 +781,13 @@ int HasCycle(Board* board, int ply) {
   if (distance < 3)
     return 0;
 
-  uint64_t original  = board->zobrist;
-  BoardHistory* prev = &board->history[board->histPly - 1];
+  // keys[-i] is the position i plies ago
+  const uint64_t original = board->zobrist;
+  const uint64_t* keys    = board->keys + board->histPly;
 
   for (int i = 3; i <= distance; i += 2) {
-    prev -= 2;
-
     uint32_t h;
-    uint64_t moveKey = original ^ prev->zobrist;
+    uint64_t moveKey = original ^ keys[-i];
     if ((h = Hash1(moveKey), cuckoo[h] == moveKey) || (h = Hash2(moveKey), cuckoo[h] == moveKey)) {
       Move move        = cuckooMove[h];
       BitBoard between = BetweenSquares(From(move), To(move));
@@ -756,14 +801,11 @@ int HasCycle(Board* board, int ply) {
       if ((pc & 1) != board->stm)
         continue;
 
-      BoardHistory* prev2 = prev - 2;
-      for (int j = i + 4; j <= distance; j += 2) {
-        prev2 -= 2;
-        if (prev2->zobrist == prev->zobrist)
+      for (int j = i + 4; j <= distance; j += 2)
+        if (keys[-j] == keys[-i])
           return 1;
-      }
     }
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -64,13 +64,29 @@ int IsLegal(Move move, Board* board);
 void InitCuckoo();
 int HasCycle(Board* board, int ply);
 
+// Threats are only computed once asked for after a move, as many nodes are
+// cut before anything needs them. Undo brings back the cached parent's.
+INLINE BitBoard Threatened(Board* board) {
+  if (!board->threatsReady)
+    SetThreats(board);
+
+  return board->threatened;
+}
+
+INLINE BitBoard ThreatenedBy(Board* board, int pieceType) {
+  if (!board->threatsReady)
+    SetThreats(board);
+
+  return board->threatenedBy[pieceType];
+}
+
 INLINE BitBoard OpponentsEasyCaptures(Board* board) {
   const int stm         = board->stm;
   const BitBoard queens = PieceBB(QUEEN, stm);
   const BitBoard rooks  = queens | PieceBB(ROOK, stm);
   const BitBoard minors = rooks | PieceBB(BISHOP, stm) | PieceBB(KNIGHT, stm);
 
-  const BitBoard pawnThreats  = board->threatenedBy[PAWN];
+  const BitBoard pawnThreats  = ThreatenedBy(board, PAWN);
   const BitBoard minorThreats = pawnThreats | board->threatenedBy[KNIGHT] | board->threatenedBy[BISHOP];
   const BitBoard rookThreats  = minorThreats | board->threatenedBy[ROOK];
 
@@ -0,0 +1,287 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "datagen.h"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bits.h"
+#include "board.h"
+#include "move.h"
+#include "search.h"
+#include "thread.h"
+#include "uci.h"
+#include "util.h"
+
+// Every thread plays its own games with its own board, searching alone with a
+// node limit. Finished games are appended to one of two buffers, a writer
+// thread writes the other out in the meantime.
+static struct {
+  FILE* fout;
+  uint64_t nodes;
+  int randomPlies;
+  int games;
+  atomic_int started, finished;
+  atomic_uint_fast64_t positions;
+
+  PackedPosition* buffers[2];
+  int active, fill, pending, done;
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+} DATAGEN;
+
+static void* DatagenWriter(void* arg) {
+  (void) arg;
+
+  pthread_mutex_lock(&DATAGEN.mutex);
+  while (1) {
+    while (!DATAGEN.pending && !DATAGEN.done)
+      pthread_cond_wait(&DATAGEN.changed, &DATAGEN.mutex);
+
+    if (!DATAGEN.pending)
+      break;
+
+    PackedPosition* buffer = DATAGEN.buffers[!DATAGEN.active];
+    int count              = DATAGEN.pending;
+    pthread_mutex_unlock(&DATAGEN.mutex);
+
+    fwrite(buffer, sizeof(PackedPosition), count, DATAGEN.fout);
+
+    pthread_mutex_lock(&DATAGEN.mutex);
+    DATAGEN.pending = 0;
+    pthread_cond_broadcast(&DATAGEN.changed);
+  }
+  pthread_mutex_unlock(&DATAGEN.mutex);
+
+  return NULL;
+}
+
+// Hands the active buffer to the writer, with the mutex held
+static void DatagenSwap() {
+  while (DATAGEN.pending)
+    pthread_cond_wait(&DATAGEN.changed, &DATAGEN.mutex);
+
+  DATAGEN.pending = DATAGEN.fill;
+  DATAGEN.active ^= 1;
+  DATAGEN.fill = 0;
+  pthread_cond_broadcast(&DATAGEN.changed);
+}
+
+static void DatagenOutput(PackedPosition* positions, int count) {
+  pthread_mutex_lock(&DATAGEN.mutex);
+
+  if (DATAGEN.fill + count > DATAGEN_BUFFER_ENTRIES)
+    DatagenSwap();
+
+  memcpy(DATAGEN.buffers[DATAGEN.active] + DATAGEN.fill, positions, count * sizeof(PackedPosition));
+  DATAGEN.fill += count;
+
+  pthread_mutex_unlock(&DATAGEN.mutex);
+}
+
+static void Pack(PackedPosition* p, Board* board, int score, Move move) {
+  memset(p, 0, sizeof(PackedPosition));
+
+  p->occupancy = OccBB(BOTH);
+  p->score     = board->stm == WHITE ? score : -score;
+  p->move      = FromTo(move);
+  p->stm       = board->stm;
+  p->fmr       = Min(255, board->fmr);
+
+  BitBoard occ = p->occupancy;
+  for (int n = 0; occ; n++)
+    p->pieces[n / 2] |= board->squares[PopLSB(&occ)] << (4 * (n & 1));
+}
+
+// splitmix64, the engine's RandomUInt64 is not thread safe
+static uint64_t NextRandom(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z          = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+static void PlayMove(Move move, Board* board) {
+  MakeMoveUpdate(move, board, 0);
+
+  if (board->fmr == 0)
+    board->histPly = board->nullply = 0;
+}
+
+// Plays random moves from the start position, returning 0 if that ended the game
+static int RandomOpening(Board* board, uint64_t* seed) {
+  ParseFen(START_FEN, board);
+
+  for (int i = 0; i < DATAGEN.randomPlies; i++) {
+    SimpleMoveList moves[1];
+    RootMoves(moves, board);
+    if (!moves->count)
+      return 0;
+
+    PlayMove(moves->moves[NextRandom(seed) % moves->count], board);
+  }
+
+  SimpleMoveList moves[1];
+  RootMoves(moves, board);
+  return moves->count > 0;
+}
+
+static int PlayGame(ThreadData* thread, PackedPosition* positions, uint64_t* seed) {
+  Board board;
+  while (!RandomOpening(&board, seed))
+    ;
+
+  int count = 0, result = 1, winPlies = 0;
+
+  for (int ply = 0; ply < DATAGEN_MAX_PLIES; ply++) {
+    SetupSingleThread(thread, &board);
+
+    if (!thread->numRootMoves) {
+      if (board.checkers)
+        result = board.stm == WHITE ? 0 : 2;
+      break;
+    }
+
+    if (IsDraw(&board, 0))
+      break;
+
+    Search(thread);
+
+    Move move = thread->rootMoves[0].move;
+    int score = thread->rootMoves[0].score;
+
+    winPlies = abs(score) >= DATAGEN_WIN_SCORE ? winPlies + 1 : 0;
+    if (winPlies >= DATAGEN_WIN_PLIES || abs(score) >= TB_WIN_BOUND) {
+      result = (score > 0) == (board.stm == WHITE) ? 2 : 0;
+      break;
+    }
+
+    // quiet positions only, the score of anything else depends on a capture
+    if (!board.checkers && !IsCap(move) && !IsPromo(move))
+      Pack(&positions[count++], &board, score, move);
+
+    PlayMove(move, &board);
+  }
+
+  for (int i = 0; i < count; i++)
+    positions[i].result = result;
+
+  return count;
+}
+
+void DatagenThread(ThreadData* thread) {
+  PackedPosition* positions = malloc(sizeof(PackedPosition) * DATAGEN_MAX_PLIES);
+  uint64_t seed             = GetTimeUS() ^ ((uint64_t) thread->idx << 32);
+
+  thread->nodeLimit = DATAGEN.nodes;
+
+  while (atomic_fetch_add(&DATAGEN.started, 1) < DATAGEN.games) {
+    int count = PlayGame(thread, positions, &seed);
+    DatagenOutput(positions, count);
+
+    uint64_t total = atomic_fetch_add(&DATAGEN.positions, count) + count;
+    int finished   = atomic_fetch_add(&DATAGEN.finished, 1) + 1;
+    if (finished % 100 == 0)
+      printf("info string datagen games %d positions %" PRIu64 "\n", finished, total);
+  }
+
+  thread->nodeLimit = 0;
+  free(positions);
+}
+
+// "datagen <file> [games n] [nodes n] [random n]" plays fixed node self-play
+// games on every thread, appending PackedPositions to file
+void Datagen(char* args) {
+  char* file = strtok(args, " \n");
+
+  DATAGEN.games       = 100;
+  DATAGEN.nodes       = DATAGEN_DEFAULT_NODES;
+  DATAGEN.randomPlies = DATAGEN_RANDOM_PLIES;
+
+  for (char* key = strtok(NULL, " \n"); key; key = strtok(NULL, " \n")) {
+    char* value = strtok(NULL, " \n");
+    if (!value)
+      break;
+
+    if (!strcmp(key, "games"))
+      DATAGEN.games = Max(1, atoi(value));
+    else if (!strcmp(key, "nodes"))
+      DATAGEN.nodes = Max(1, strtoull(value, NULL, 10));
+    else if (!strcmp(key, "random"))
+      DATAGEN.randomPlies = Max(0, Min(DATAGEN_MAX_PLIES, atoi(value)));
+  }
+
+  DATAGEN.fout = file ? fopen(file, "ab") : NULL;
+  if (!DATAGEN.fout) {
+    printf("info string Unable to open %s\n", file ? file : "");
+    return;
+  }
+
+  // Search reads these, the root moves are set up by each thread
+  SetSearchLimits(0, 0, 0, 1);
+  Limits.independent = 1;
+  Limits.quiet       = 1;
+
+  Threads.stop = 0;
+
+  DATAGEN.buffers[0] = malloc(sizeof(PackedPosition) * DATAGEN_BUFFER_ENTRIES);
+  DATAGEN.buffers[1] = malloc(sizeof(PackedPosition) * DATAGEN_BUFFER_ENTRIES);
+  DATAGEN.active = DATAGEN.fill = DATAGEN.pending = DATAGEN.done = 0;
+  atomic_store(&DATAGEN.started, 0);
+  atomic_store(&DATAGEN.finished, 0);
+  atomic_store(&DATAGEN.positions, 0);
+  pthread_mutex_init(&DATAGEN.mutex, NULL);
+  pthread_cond_init(&DATAGEN.changed, NULL);
+
+  pthread_t writer;
+  pthread_create(&writer, NULL, DatagenWriter, NULL);
+
+  long startTime = GetTimeMS();
+
+  ThreadsRun(THREAD_DATAGEN);
+  ThreadsWait();
+
+  pthread_mutex_lock(&DATAGEN.mutex);
+  if (DATAGEN.fill)
+    DatagenSwap();
+  DATAGEN.done = 1;
+  pthread_cond_broadcast(&DATAGEN.changed);
+  pthread_mutex_unlock(&DATAGEN.mutex);
+  pthread_join(writer, NULL);
+
+  long time = GetTimeMS() - startTime;
+  printf("info string datagen wrote %" PRIu64 " positions from %d games to %s in %ldms (%.1f positions per second)\n",
+         (uint64_t) atomic_load(&DATAGEN.positions),
+         atomic_load(&DATAGEN.finished),
+         file,
+         time,
+         1000.0 * atomic_load(&DATAGEN.positions) / Max(1, time));
+
+  Limits.independent = 0;
+  Limits.quiet       = 0;
+
+  fclose(DATAGEN.fout);
+  free(DATAGEN.buffers[0]);
+  free(DATAGEN.buffers[1]);
+  pthread_mutex_destroy(&DATAGEN.mutex);
+  pthread_cond_destroy(&DATAGEN.changed);
+}
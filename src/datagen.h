@@ -0,0 +1,49 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+#define DATAGEN_DEFAULT_NODES  5000
+#define DATAGEN_RANDOM_PLIES   8
+#define DATAGEN_MAX_PLIES      400
+#define DATAGEN_WIN_SCORE      2000 // adjudicated after DATAGEN_WIN_PLIES plies past it
+#define DATAGEN_WIN_PLIES      4
+#define DATAGEN_BUFFER_ENTRIES (1 << 16)
+
+// One training position, 32 bytes. pieces holds a 4 bit piece (Board.squares)
+// per set bit of occupancy, lowest square first and low nibble first
+typedef struct __attribute__((packed)) {
+  uint64_t occupancy;
+  uint8_t pieces[16];
+  int16_t score;  // search score from white's point of view
+  uint16_t move;  // FromTo() of the best move
+  uint8_t result; // 0 black win, 1 draw, 2 white win
+  uint8_t stm;
+  uint8_t fmr;
+  uint8_t padding;
+} PackedPosition;
+
+_Static_assert(sizeof(PackedPosition) == 32, "PackedPosition must be 32 bytes");
+
+void DatagenThread(ThreadData* thread);
+void Datagen(char* args);
+
+#endif
@@ -24,12 +24,18 @@
 #include "move.h"
 #include "nn/accumulator.h"
 #include "nn/evaluate.h"
+#include "stats.h"
 #include "uci.h"
 #include "util.h"
 
 const int PHASE_VALUES[6] = {0, 3, 3, 5, 10, 0};
 const int MAX_PHASE       = 64;
 
+// Material imbalance (in pawns) at which the small network takes over
+#define SMALL_NET_IMBALANCE 7
+
+const int IMBALANCE_VALUES[5] = {1, 3, 3, 5, 9};
+
 void SetContempt(int* dest, int stm) {
   int contempt = CONTEMPT;
 
@@ -37,22 +43,63 @@ void SetContempt(int* dest, int stm) {
   dest[stm ^ 1] = -contempt;
 }
 
+// Absolute material difference, read straight from the material key
+INLINE int MaterialImbalance(Board* board) {
+  int imbalance = 0;
+  for (int pc = PAWN; pc <= QUEEN; pc++) {
+    const int white = (board->piecesCounts >> (Piece(pc, WHITE) * 4)) & 0xF;
+    const int black = (board->piecesCounts >> (Piece(pc, BLACK) * 4)) & 0xF;
+    imbalance += IMBALANCE_VALUES[pc] * (white - black);
+  }
+
+  return abs(imbalance);
+}
+
 // Main evalution method
 Score Evaluate(Board* board, ThreadData* thread) {
   if (IsMaterialDraw(board))
     return 0;
 
-  Accumulator* acc = board->accumulators;
-  for (int c = WHITE; c <= BLACK; c++) {
-    if (!acc->correct[c]) {
-      if (CanEfficientlyUpdate(acc, c))
-        ApplyLazyUpdates(acc, board, c);
-      else
-        RefreshAccumulator(acc, board, c);
+  // Transpositions skip both the accumulator updates and the propagation,
+  // a skipped accumulator is simply brought up to date by a later update
+  EvalCacheEntry* entry = &thread->evalCache[board->zobrist & EVAL_CACHE_MASK];
+  const uint32_t key    = board->zobrist >> 32;
+  int score;
+
+  StatsInc(thread, evalCacheProbes);
+  if (entry->key == key) {
+    StatsInc(thread, evalCacheHits);
+    score = entry->score;
+  } else {
+    // Lopsided positions are decided by the material, so the cheaper
+    // small network (when loaded) is good enough for them
+    const int small                    = SMALL_NETWORK.hidden && MaterialImbalance(board) >= SMALL_NET_IMBALANCE;
+    const Network* net                 = small ? &SMALL_NETWORK : &NETWORK;
+    Accumulator* acc                   = small ? board->smallAccumulators : board->accumulators;
+    AccumulatorKingState* refreshTable = small ? board->smallRefreshTable : board->refreshTable;
+
+    if (small)
+      StatsInc(thread, nnSmallEvals);
+
+    for (int c = WHITE; c <= BLACK; c++) {
+      if (!acc->correct[c]) {
+        if (CanEfficientlyUpdate(acc, c)) {
+          const int plies = ApplyLazyUpdates(net, acc, board, c);
+          StatsInc(thread, nnLazyUpdates);
+          StatsAdd(thread, nnLazyPlies, plies);
+        } else {
+          const int features = RefreshAccumulator(net, acc, refreshTable, board, c);
+          StatsInc(thread, nnRefreshes);
+          StatsAdd(thread, nnRefreshFeatures, features);
+        }
+      }
     }
-  }
 
-  int score = board->stm == WHITE ? Propagate(acc, WHITE) : Propagate(acc, BLACK);
+    score = board->stm == WHITE ? Propagate(net, acc, WHITE) : Propagate(net, acc, BLACK);
+
+    entry->key   = key;
+    entry->score = score;
+  }
 
   // scaled based on phase [1, 1.5]
   score = (128 + board->phase) * score / 128;
@@ -65,10 +112,10 @@ void EvaluateTrace(Board* board) {
   // The UCI board has no guarantee of accumulator allocation
   // so we have to set that up here.
   board->accumulators = AlignedMalloc(sizeof(Accumulator), 64);
-  ResetAccumulator(board->accumulators, board, WHITE);
-  ResetAccumulator(board->accumulators, board, BLACK);
+  ResetAccumulator(&NETWORK, board->accumulators, board, WHITE);
+  ResetAccumulator(&NETWORK, board->accumulators, board, BLACK);
 
-  int base   = Propagate(board->accumulators, board->stm);
+  int base   = Propagate(&NETWORK, board->accumulators, board->stm);
   base       = board->stm == WHITE ? base : -base;
   int scaled = (128 + board->phase) * base / 128;
 
@@ -94,9 +141,9 @@ void EvaluateTrace(Board* board) {
         // To calculate the piece value, we pop it
         // reset the accumulators and take a diff
         PopBit(OccBB(BOTH), sq);
-        ResetAccumulator(board->accumulators, board, WHITE);
-        ResetAccumulator(board->accumulators, board, BLACK);
-        int new = Propagate(board->accumulators, board->stm);
+        ResetAccumulator(&NETWORK, board->accumulators, board, WHITE);
+        ResetAccumulator(&NETWORK, board->accumulators, board, BLACK);
+        int new = Propagate(&NETWORK, board->accumulators, board->stm);
         new     = board->stm == WHITE ? new : -new;
         SetBit(OccBB(BOTH), sq);
 
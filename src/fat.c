@@ -0,0 +1,176 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// Launcher for fat binaries (make fat). The whole engine is compiled once per
+// entry of FAT_ARCHS, each copy with its own symbols hidden and main renamed to
+// BerserkMain_<arch>. This picks the best copy the CPU can run, which can be
+// overridden with the BERSERK_ARCH environment variable.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <cpuid.h>
+#endif
+
+#define INCBIN_PREFIX
+#define INCBIN_STYLE INCBIN_STYLE_CAMEL
+#include "incbin.h"
+
+// Shared by every copy, see nn/evaluate.c
+INCBIN(Embed, EVALFILE);
+
+#define X(arch) int BerserkMain_##arch(int argc, char** argv);
+FAT_VARIANTS
+#undef X
+
+typedef struct {
+  const char* name;
+  int (*main)(int argc, char** argv);
+} FatVariant;
+
+// In order of preference, as listed in FAT_ARCHS
+#define X(arch) {#arch, BerserkMain_##arch},
+const FatVariant VARIANTS[] = {FAT_VARIANTS};
+#undef X
+
+const int NUM_VARIANTS = sizeof(VARIANTS) / sizeof(FatVariant);
+
+enum {
+  CPU_POPCNT     = 1 << 0,
+  CPU_SSSE3      = 1 << 1,
+  CPU_AVX2       = 1 << 2,
+  CPU_AVXVNNI    = 1 << 3,
+  CPU_AVX512     = 1 << 4,
+  CPU_AVX512VNNI = 1 << 5,
+  CPU_PEXT       = 1 << 6,
+};
+
+static int CpuFeatures() {
+  int features = 0;
+
+#if defined(__x86_64__) || defined(_M_X64)
+  unsigned a, b, c, d;
+  if (!__get_cpuid(0, &a, &b, &c, &d))
+    return 0;
+
+  const unsigned maxLeaf = a;
+  const int amd          = b == 0x68747541; // "Auth"enticAMD
+
+  __get_cpuid(1, &a, &b, &c, &d);
+  const int family = ((a >> 8) & 0xF) + ((a >> 20) & 0xFF);
+
+  if (c & (1 << 23))
+    features |= CPU_POPCNT;
+  if (c & (1 << 9))
+    features |= CPU_SSSE3;
+
+  // The OS has to save the wider registers for them to be usable
+  uint64_t xcr0 = 0;
+  if (c & (1 << 27)) {
+    unsigned lo, hi;
+    __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    xcr0 = ((uint64_t) hi << 32) | lo;
+  }
+
+  const int fma   = c & (1 << 12);
+  const int sse41 = c & (1 << 19);
+  const int ymm   = (xcr0 & 0x06) == 0x06;
+  const int zmm   = ymm && (xcr0 & 0xE0) == 0xE0;
+
+  if (maxLeaf >= 7) {
+    __cpuid_count(7, 0, a, b, c, d);
+
+    const int bmi2 = b & (1 << 8);
+
+    if (ymm && fma && sse41 && (b & (1 << 3)) && (b & (1 << 5)))
+      features |= CPU_AVX2;
+    if ((features & CPU_AVX2) && zmm && (b & (1 << 16)) && (b & (1 << 30)))
+      features |= CPU_AVX512;
+    if ((features & CPU_AVX512) && (c & (1 << 11)))
+      features |= CPU_AVX512VNNI;
+
+    // pext is microcoded (and slow) on Zen 1 and 2
+    if (bmi2 && !(amd && family == 0x17))
+      features |= CPU_PEXT;
+
+    __cpuid_count(7, 1, a, b, c, d);
+    if ((features & CPU_AVX2) && (a & (1 << 4)))
+      features |= CPU_AVXVNNI;
+  }
+#endif
+
+  return features;
+}
+
+// The features a variant needs, from its name as the makefile's ARCH does
+static int Requires(const char* arch) {
+  int features = CPU_POPCNT;
+
+  if (strstr(arch, "avx512vnni"))
+    features |= CPU_AVX512VNNI | CPU_AVX512 | CPU_AVX2 | CPU_SSSE3;
+  else if (strstr(arch, "avx512"))
+    features |= CPU_AVX512 | CPU_AVX2 | CPU_SSSE3;
+  else if (strstr(arch, "avxvnni"))
+    features |= CPU_AVXVNNI | CPU_AVX2 | CPU_SSSE3;
+  else if (strstr(arch, "avx2"))
+    features |= CPU_AVX2 | CPU_SSSE3;
+  else if (strstr(arch, "ssse3"))
+    features |= CPU_SSSE3;
+
+  if (strstr(arch, "pext"))
+    features |= CPU_PEXT;
+
+  return features;
+}
+
+int main(int argc, char** argv) {
+  const int features = CpuFeatures();
+  const char* forced = getenv("BERSERK_ARCH");
+  if (forced && !*forced)
+    forced = NULL;
+
+  for (int i = 0; i < NUM_VARIANTS; i++) {
+    const char* name = VARIANTS[i].name;
+    const int needed = Requires(name);
+
+    if ((features & needed) != needed)
+      continue;
+
+    // ARCH names use dashes, identifiers underscores
+    if (forced) {
+      char arch[32];
+      snprintf(arch, sizeof(arch), "%s", forced);
+      for (char* ch = arch; *ch; ch++)
+        if (*ch == '-')
+          *ch = '_';
+
+      if (strcmp(arch, name))
+        continue;
+    }
+
+    return VARIANTS[i].main(argc, argv);
+  }
+
+  if (forced)
+    fprintf(stderr, "Berserk was not built for %s, or this CPU cannot run it\n", forced);
+  else
+    fprintf(stderr, "None of the architectures Berserk was built for are supported by this CPU\n");
+
+  return 1;
+}
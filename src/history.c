@@ -18,6 +18,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
 #include "move.h"
@@ -34,6 +35,9 @@ void UpdateHistories(SearchStack* ss,
   Board* board = &thread->board;
   int stm      = board->stm;
 
+  // a hash move cutoff can come before anything computed them
+  Threatened(board);
+
   int16_t inc = HistoryBonus(depth);
 
   if (!IsCap(bestMove)) {
@@ -87,9 +91,34 @@ void UpdateHistories(SearchStack* ss,
   }
 }
 
+// One correction table for all threads, racing updates may drop one another
+int SHARED_CORRECTION = 0;
+_Atomic int16_t SHARED_PAWN_CORRECTION[PAWN_CORRECTION_SIZE];
+
 void UpdatePawnCorrection(int raw, int real, Board* board, ThreadData* thread) {
   const int16_t correction = Min(30000, Max(-30000, (real - raw) * PAWN_CORRECTION_GRAIN));
   const int idx            = (board->pawnZobrist & PAWN_CORRECTION_MASK);
 
+  if (SHARED_CORRECTION) {
+    const int16_t prev = LoadRlx(SHARED_PAWN_CORRECTION[idx]);
+    atomic_store_explicit(&SHARED_PAWN_CORRECTION[idx], (prev * 255 + correction) / 256, memory_order_relaxed);
+    return;
+  }
+
   thread->pawnCorrection[idx] = (thread->pawnCorrection[idx] * 255 + correction) / 256;
 }
+
+void ClearSharedHistory() {
+  for (int i = 0; i < PAWN_CORRECTION_SIZE; i++)
+    atomic_store_explicit(&SHARED_PAWN_CORRECTION[i], 0, memory_order_relaxed);
+}
+
+// Start a helper off with what another thread (the main one) has learned,
+// neither may be searching
+void SeedHistory(ThreadData* thread, ThreadData* from) {
+  memcpy(thread->counters, from->counters, sizeof(thread->counters));
+  memcpy(thread->hh, from->hh, sizeof(thread->hh));
+  memcpy(thread->ch, from->ch, sizeof(thread->ch));
+  memcpy(thread->caph, from->caph, sizeof(thread->caph));
+  memcpy(thread->pawnCorrection, from->pawnCorrection, sizeof(thread->pawnCorrection));
+}
@@ -23,14 +23,54 @@
 #include "types.h"
 #include "util.h"
 
+extern int SHARED_CORRECTION;
+extern _Atomic int16_t SHARED_PAWN_CORRECTION[PAWN_CORRECTION_SIZE];
+
 #define HH(stm, m, threats) (thread->hh[stm][!GetBit(threats, From(m))][!GetBit(threats, To(m))][FromTo(m)])
 #define TH(p, e, d, c)      (thread->caph[p][e][d][c])
 
+// The tables a node gathers quiet history from, resolved once per node so
+// each move indexes them directly instead of going through ss and thread
+typedef struct {
+  int16_t (*hh)[2][64 * 64]; // hh[stm], then indexed by the threats on from / to
+  PieceTo* ch[4];            // continuation histories of ss - 1, 2, 4 and 6
+  Board* board;              // threats are still only computed when first needed
+} HistoryTables;
+
+INLINE void InitHistoryTables(HistoryTables* tables, SearchStack* ss, ThreadData* thread, Board* board) {
+  tables->hh    = thread->hh[board->stm];
+  tables->ch[0] = (ss - 1)->ch;
+  tables->ch[1] = (ss - 2)->ch;
+  tables->ch[2] = (ss - 4)->ch;
+  tables->ch[3] = (ss - 6)->ch;
+  tables->board = board;
+}
+
+INLINE int16_t TablesHH(const HistoryTables* tables, Move move) {
+  const BitBoard threatened = Threatened(tables->board);
+  return tables->hh[!GetBit(threatened, From(move))][!GetBit(threatened, To(move))][FromTo(move)];
+}
+
+// ch[i] is the row of the move 1, 2, 4 or 6 plies back
+INLINE int16_t* TablesCHEntry(const HistoryTables* tables, int i, Move move) {
+  return &(*tables->ch[i])[CHPiece(Moving(move), i ? 2 * i : 1)][To(move)];
+}
+
+INLINE int16_t TablesCH(const HistoryTables* tables, int i, Move move) {
+  return *TablesCHEntry(tables, i, move);
+}
+
+// Same as GetQuietHistory
+INLINE int TablesQuietHistory(const HistoryTables* tables, Move move) {
+  return (int) TablesHH(tables, move) + (int) TablesCH(tables, 0, move) + (int) TablesCH(tables, 1, move) +
+         (int) TablesCH(tables, 2, move);
+}
+
 INLINE int GetQuietHistory(SearchStack* ss, ThreadData* thread, Move move) {
-  return (int) HH(thread->board.stm, move, thread->board.threatened) + //
-         (int) (*(ss - 1)->ch)[Moving(move)][To(move)] +               //
-         (int) (*(ss - 2)->ch)[Moving(move)][To(move)] +               //
-         (int) (*(ss - 4)->ch)[Moving(move)][To(move)];
+  return (int) HH(thread->board.stm, move, Threatened(&thread->board)) + //
+         (int) (*(ss - 1)->ch)[CHPiece(Moving(move), 1)][To(move)] +     //
+         (int) (*(ss - 2)->ch)[CHPiece(Moving(move), 2)][To(move)] +     //
+         (int) (*(ss - 4)->ch)[CHPiece(Moving(move), 4)][To(move)];
 }
 
 INLINE int GetCaptureHistory(ThreadData* thread, Move move) {
@@ -38,7 +78,7 @@ INLINE int GetCaptureHistory(ThreadData* thread, Move move) {
 
   return TH(Moving(move),
             To(move),
-            !GetBit(board->threatened, To(move)),
+            !GetBit(Threatened(board), To(move)),
             IsEP(move) ? PAWN : PieceType(board->squares[To(move)]));
 }
 
@@ -67,17 +107,22 @@ INLINE void AddHistoryHeuristic(int16_t* entry, int16_t inc) {
 
 INLINE void UpdateCH(SearchStack* ss, Move move, int16_t bonus) {
   if ((ss - 1)->move)
-    AddHistoryHeuristic(&(*(ss - 1)->ch)[Moving(move)][To(move)], bonus);
+    AddHistoryHeuristic(&(*(ss - 1)->ch)[CHPiece(Moving(move), 1)][To(move)], bonus);
   if ((ss - 2)->move)
-    AddHistoryHeuristic(&(*(ss - 2)->ch)[Moving(move)][To(move)], bonus);
+    AddHistoryHeuristic(&(*(ss - 2)->ch)[CHPiece(Moving(move), 2)][To(move)], bonus);
   if ((ss - 4)->move)
-    AddHistoryHeuristic(&(*(ss - 4)->ch)[Moving(move)][To(move)], bonus);
+    AddHistoryHeuristic(&(*(ss - 4)->ch)[CHPiece(Moving(move), 4)][To(move)], bonus);
   if ((ss - 6)->move)
-    AddHistoryHeuristic(&(*(ss - 6)->ch)[Moving(move)][To(move)], bonus);
+    AddHistoryHeuristic(&(*(ss - 6)->ch)[CHPiece(Moving(move), 6)][To(move)], bonus);
 }
 
 INLINE int GetPawnCorrection(Board* board, ThreadData* thread) {
-  return thread->pawnCorrection[board->pawnZobrist & PAWN_CORRECTION_MASK] / PAWN_CORRECTION_GRAIN;
+  const int idx = board->pawnZobrist & PAWN_CORRECTION_MASK;
+
+  if (SHARED_CORRECTION)
+    return LoadRlx(SHARED_PAWN_CORRECTION[idx]) / PAWN_CORRECTION_GRAIN;
+
+  return thread->pawnCorrection[idx] / PAWN_CORRECTION_GRAIN;
 }
 
 void UpdateHistories(SearchStack* ss,
@@ -90,5 +135,7 @@ void UpdateHistories(SearchStack* ss,
                      int nC);
 
 void UpdatePawnCorrection(int raw, int real, Board* board, ThreadData* thread);
+void ClearSharedHistory();
+void SeedHistory(ThreadData* thread, ThreadData* from);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,172 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "libberserk.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attacks.h"
+#include "board.h"
+#include "move.h"
+#include "nn/evaluate.h"
+#include "numa.h"
+#include "random.h"
+#include "search.h"
+#include "thread.h"
+#include "transposition.h"
+#include "types.h"
+#include "uci.h"
+#include "util.h"
+#include "zobrist.h"
+
+static Board BOARD;
+
+static BerserkCallback REPORT_CALLBACK;
+static void* REPORT_DATA;
+static BerserkResult* RESULT;
+
+// The same info PrintUCI prints for root move i
+static void FillResult(BerserkResult* r, ThreadData* thread, Board* board, int i, int alpha, int beta) {
+  RootMove* rm = &thread->rootMoves[i];
+
+  int updated = rm->score != -CHECKMATE;
+  int bounded = updated ? Max(alpha, Min(beta, rm->score)) : rm->previousScore;
+  int ply     = Max(0, 2 * (board->moveNo - 1)) + board->stm;
+
+  r->multiPV  = i + 1;
+  r->depth    = updated ? thread->depth : Max(1, thread->depth - 1);
+  r->seldepth = rm->seldepth;
+  r->mate     = bounded > MATE_BOUND ? (CHECKMATE - bounded + 1) / 2 : bounded < -MATE_BOUND ? -(CHECKMATE + bounded) / 2 : 0;
+  r->cp       = abs(bounded) > TB_WIN_BOUND ? bounded : Normalize(bounded);
+  r->bound    = !updated ? 0 : bounded >= beta ? 1 : bounded <= alpha ? -1 : 0;
+  r->wdl[0]   = WRModel(bounded, ply);
+  r->wdl[2]   = WRModel(-bounded, ply);
+  r->wdl[1]   = 1000 - r->wdl[0] - r->wdl[2];
+  r->nodes    = NodesSearched();
+  r->tbhits   = TBHits();
+  r->time     = Max(1, GetTimeMS() - Limits.start);
+  r->nps      = 1000 * r->nodes / r->time;
+  r->hashfull = TTFull();
+
+  // An unfinished first iteration only has the move
+  r->pvLength = Min(BERSERK_MAX_PV, Max(1, rm->pv.count));
+  for (int j = 0; j < r->pvLength; j++)
+    snprintf(r->pv[j], sizeof(r->pv[j]), "%s", MoveToStr(rm->pv.moves[j], board));
+}
+
+static void Report(ThreadData* thread, Board* board, int alpha, int beta, Move bestMove, Move ponderMove) {
+  BerserkResult r = {0};
+
+  if (!bestMove) {
+    for (int i = 0; i < Min(Limits.multiPV, thread->numRootMoves); i++) {
+      if (thread->depth == 1 && i > 0 && thread->rootMoves[i].score == -CHECKMATE)
+        break;
+
+      FillResult(&r, thread, board, i, alpha, beta);
+      if (REPORT_CALLBACK)
+        REPORT_CALLBACK(&r, REPORT_DATA);
+    }
+
+    return;
+  }
+
+  FillResult(&r, thread, board, 0, alpha, beta);
+  r.depth = Max(1, thread->completedDepth); // thread->depth is past the last iteration here
+  snprintf(r.bestMove, sizeof(r.bestMove), "%s", MoveToStr(bestMove, board));
+  if (ponderMove)
+    snprintf(r.ponderMove, sizeof(r.ponderMove), "%s", MoveToStr(ponderMove, board));
+
+  if (RESULT)
+    *RESULT = r;
+}
+
+void BerserkInit(int hashMB, int threads) {
+  SeedRandom(0);
+
+  InitZobristKeys();
+  InitPruningAndReductionTables();
+  InitAttacks();
+  InitCuckoo();
+
+  LoadDefaultNN();
+  NumaInit();
+  ThreadsInit();
+  ThreadsSetNumber(Max(1, threads));
+  TTInit(Max(2, hashMB));
+
+  ParseFen(START_FEN, &BOARD);
+}
+
+void BerserkFree() {
+  ThreadsExit();
+  TTFree();
+}
+
+void BerserkNewGame() {
+  SearchClear();
+  TTClear();
+}
+
+int BerserkSetPosition(const char* fen, const char* moves) {
+  char buffer[8192];
+
+  snprintf(buffer, sizeof(buffer), "%s", fen ? fen : START_FEN);
+  ParseFen(buffer, &BOARD);
+
+  if (!moves)
+    return 1;
+
+  snprintf(buffer, sizeof(buffer), "%s", moves);
+  for (char* move = strtok(buffer, " "); move != NULL; move = strtok(NULL, " ")) {
+    Move m = ParseMove(move, &BOARD);
+    if (!m)
+      return 0;
+
+    MakeMoveUpdate(m, &BOARD, 0);
+
+    if (BOARD.fmr == 0)
+      BOARD.histPly = BOARD.nullply = 0;
+  }
+
+  return 1;
+}
+
+void BerserkSearch(const BerserkLimits* limits, BerserkCallback callback, void* data, BerserkResult* result) {
+  SimpleMoveList rootMoves;
+  RootMoves(&rootMoves, &BOARD);
+
+  REPORT_CALLBACK = callback;
+  REPORT_DATA     = data;
+  RESULT          = result;
+
+  SetSearchLimits(limits->depth, limits->nodes, limits->movetime, Min(limits->multiPV, rootMoves.count));
+  Limits.quiet  = 1;
+  Limits.report = Report;
+
+  StartSearch(&BOARD, 0);
+  ThreadWaitUntilSleep(Threads.threads[0]);
+
+  Limits.report   = NULL;
+  REPORT_CALLBACK = NULL;
+  RESULT          = NULL;
+}
+
+void BerserkStop() {
+  Threads.stop = 1;
+}
@@ -0,0 +1,75 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef LIBBERSERK_H
+#define LIBBERSERK_H
+
+// Public interface of libberserk (make lib), usable without any other
+// engine header. The engine is a process wide singleton: one search at a time.
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define BERSERK_API __declspec(dllexport)
+#else
+#define BERSERK_API __attribute__((visibility("default")))
+#endif
+
+#define BERSERK_MAX_PV 64
+
+typedef struct {
+  int depth;       // 0 for no depth limit
+  uint64_t nodes;  // 0 for no node limit
+  int movetime;    // milliseconds, 0 for no time limit
+  int multiPV;     // number of lines, 0 is treated as 1
+} BerserkLimits;
+
+typedef struct {
+  int multiPV; // 1 based line number
+  int depth, seldepth;
+  int cp;      // normalized to 50% win rate at 100cp
+  int mate;    // moves to mate, negative when getting mated, 0 if none
+  int bound;   // 1 for lowerbound, -1 for upperbound, 0 for exact
+  int wdl[3];  // per mille win, draw, loss for the side to move
+  uint64_t nodes, nps, tbhits, time;
+  int hashfull;
+  int pvLength;
+  char pv[BERSERK_MAX_PV][6];
+  char bestMove[6], ponderMove[6]; // only set in the final result
+} BerserkResult;
+
+// Called from the engine's main search thread for every info line
+typedef void (*BerserkCallback)(const BerserkResult* result, void* data);
+
+BERSERK_API void BerserkInit(int hashMB, int threads);
+BERSERK_API void BerserkFree();
+
+BERSERK_API void BerserkNewGame();
+
+// fen may be NULL for the start position, moves is a space separated list of
+// uci moves or NULL. Returns 0 if a move was illegal.
+BERSERK_API int BerserkSetPosition(const char* fen, const char* moves);
+
+// Blocks until the search completes, filling *result with the best line
+BERSERK_API void BerserkSearch(const BerserkLimits* limits,
+                               BerserkCallback callback,
+                               void* data,
+                               BerserkResult* result);
+
+// Can be called from any thread while BerserkSearch is running
+BERSERK_API void BerserkStop();
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "movepick.h"
 
+#include <limits.h>
 #include <stdio.h>
 
 #include "board.h"
@@ -24,9 +25,31 @@
 #include "move.h"
 #include "movegen.h"
 #include "see.h"
+#include "stats.h"
 #include "transposition.h"
 #include "types.h"
 
+int PARTIAL_SORT = 0;
+
+// Quiets scoring below -QUIET_SORT_LIMIT * depth are played in generation order
+#define QUIET_SORT_LIMIT 4096
+
+// Moves every move scoring at least limit to the front, best first, leaving the rest in the order they came
+INLINE void PartialInsertionSort(ScoredMove* begin, ScoredMove* end, int limit) {
+  for (ScoredMove *sortedEnd = begin, *p = begin + 1; p < end; p++) {
+    if (p->score < limit)
+      continue;
+
+    ScoredMove temp = *p;
+    ScoredMove* q;
+
+    *p = *++sortedEnd;
+    for (q = sortedEnd; q != begin && (q - 1)->score < temp.score; q--)
+      *q = *(q - 1);
+    *q = temp;
+  }
+}
+
 INLINE Move Best(ScoredMove* current, ScoredMove* end) {
   ScoredMove* orig = current;
   ScoredMove* max  = current;
@@ -42,16 +65,33 @@ INLINE Move Best(ScoredMove* current, ScoredMove* end) {
   return orig->move;
 }
 
+// Sorted lists are already in order, otherwise select the best of what is left
+INLINE Move Pick(MovePicker* picker) {
+  StatsInc(picker->thread, mpPicked);
+  return PARTIAL_SORT ? (picker->current++)->move : Best(picker->current++, picker->end);
+}
+
 INLINE void ScoreMoves(MovePicker* picker, Board* board, const int type) {
   ScoredMove* current = picker->current;
   ThreadData* thread  = picker->thread;
   SearchStack* ss     = picker->ss;
 
-  const BitBoard pawnThreats  = board->threatenedBy[PAWN];
+  StatsAdd(thread, mpScored, picker->end - picker->current);
+
+  const BitBoard pawnThreats  = ThreatenedBy(board, PAWN);
   const BitBoard minorThreats = pawnThreats | board->threatenedBy[KNIGHT] | board->threatenedBy[BISHOP];
   const BitBoard rookThreats  = minorThreats | board->threatenedBy[ROOK];
   const BitBoard threats[3]   = {pawnThreats, minorThreats, rookThreats};
 
+  HistoryTables tables;
+  if (type == ST_QUIET || type == ST_EVASION_QT)
+    InitHistoryTables(&tables, ss, thread, board);
+
+#if defined(STATS)
+  // Distinct cache lines read from each continuation history, see mpQuietLines
+  uint32_t lines[4] = {0};
+#endif
+
   while (current < picker->end) {
     const Move move    = current->move;
     const int from     = From(move);
@@ -61,11 +101,16 @@ INLINE void ScoreMoves(MovePicker* picker, Board* board, const int type) {
     const int captured = IsEP(move) ? PAWN : PieceType(board->squares[to]);
 
     if (type == ST_QUIET || type == ST_EVASION_QT) {
-      current->score = (int) HH(board->stm, move, board->threatened) * 2 + //
-                       (int) (*(ss - 1)->ch)[pc][to] * 2 +                 //
-                       (int) (*(ss - 2)->ch)[pc][to] * 2 +                 //
-                       (int) (*(ss - 4)->ch)[pc][to] +                     //
-                       (int) (*(ss - 6)->ch)[pc][to];
+      current->score = (int) TablesHH(&tables, move) * 2 +    //
+                       (int) TablesCH(&tables, 0, move) * 2 + //
+                       (int) TablesCH(&tables, 1, move) * 2 + //
+                       (int) TablesCH(&tables, 2, move) +     //
+                       (int) TablesCH(&tables, 3, move);
+
+#if defined(STATS)
+      for (int i = 0; i < 4; i++)
+        lines[i] |= 1u << (((uintptr_t) TablesCHEntry(&tables, i, move) >> 6) - ((uintptr_t) tables.ch[i] >> 6));
+#endif
 
       if (pt != PAWN && pt != KING) {
         const BitBoard danger = threats[Max(0, pt - BISHOP)];
@@ -86,16 +131,32 @@ INLINE void ScoreMoves(MovePicker* picker, Board* board, const int type) {
 
     current++;
   }
+
+#if defined(STATS)
+  if (type == ST_QUIET || type == ST_EVASION_QT) {
+    StatsAdd(thread, mpQuietGathers, 4 * (picker->end - picker->current));
+    for (int i = 0; i < 4; i++)
+      StatsAdd(thread, mpQuietLines, BitCount(lines[i]));
+  }
+#endif
+
+  if (PARTIAL_SORT)
+    PartialInsertionSort(picker->current, picker->end, type == ST_QUIET ? -QUIET_SORT_LIMIT * picker->depth : INT_MIN);
 }
 
 Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
   switch (picker->phase) {
     case HASH_MOVE:
+      StatsInc(picker->thread, mpPickers);
       picker->phase = GEN_NOISY_MOVES;
-      if (IsPseudoLegal(picker->hashMove, board))
+      if (IsPseudoLegal(picker->hashMove, board)) {
+        StatsInc(picker->thread, hashMoves);
         return picker->hashMove;
+      } else if (picker->hashMove)
+        StatsInc(picker->thread, hashMovesIllegal);
       // fallthrough
     case GEN_NOISY_MOVES:
+      StatsInc(picker->thread, mpNoisy);
       picker->current = picker->endBad = picker->moves;
       picker->end                      = AddNoisyMoves(picker->current, board);
 
@@ -105,9 +166,8 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case PLAY_GOOD_NOISY:
       while (picker->current != picker->end) {
-        Move move = Best(picker->current, picker->end);
-        int score = picker->current->score;
-        picker->current++;
+        Move move = Pick(picker);
+        int score = (picker->current - 1)->score;
 
         if (move == picker->hashMove)
           continue;
@@ -121,6 +181,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       picker->phase = PLAY_KILLER_1;
       // fallthrough
     case PLAY_KILLER_1:
+      StatsInc(picker->thread, mpKillers);
       picker->phase = PLAY_KILLER_2;
       if (!skipQuiets && picker->killer1 != picker->hashMove && IsPseudoLegal(picker->killer1, board))
         return picker->killer1;
@@ -138,6 +199,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case GEN_QUIET_MOVES:
       if (!skipQuiets) {
+        StatsInc(picker->thread, mpQuiets);
         picker->current = picker->endBad;
         picker->end     = AddQuietMoves(picker->current, board);
 
@@ -148,7 +210,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case PLAY_QUIETS:
       while (picker->current != picker->end && !skipQuiets) {
-        Move move = Best(picker->current++, picker->end);
+        Move move = Pick(picker);
 
         if (move != picker->hashMove && //
             move != picker->killer1 &&  //
@@ -157,6 +219,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
           return move;
       }
 
+      StatsInc(picker->thread, mpBadNoisy);
       picker->current = picker->moves;
       picker->end     = picker->endBad;
 
@@ -175,6 +238,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
 
     // Probcut MP Steps
     case PC_GEN_NOISY_MOVES:
+      StatsInc(picker->thread, mpProbcut);
       picker->current = picker->endBad = picker->moves;
       picker->end                      = AddNoisyMoves(picker->current, board);
 
@@ -184,7 +248,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case PC_PLAY_GOOD_NOISY:
       while (picker->current != picker->end) {
-        Move move = Best(picker->current++, picker->end);
+        Move move = Pick(picker);
 
         if (SEE(board, move, picker->seeCutoff))
           return move;
@@ -195,6 +259,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
 
     // QSearch MP Steps
     case QS_GEN_NOISY_MOVES:
+      StatsInc(picker->thread, mpQsNoisy);
       picker->current = picker->moves;
       picker->end     = AddNoisyMoves(picker->current, board);
 
@@ -204,7 +269,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case QS_PLAY_NOISY_MOVES:
       while (picker->current != picker->end)
-        return Best(picker->current++, picker->end);
+        return Pick(picker);
 
       if (!picker->genChecks) {
         picker->phase = -1;
@@ -215,6 +280,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
 
       // fallthrough
     case QS_GEN_QUIET_CHECKS:
+      StatsInc(picker->thread, mpQsChecks);
       picker->current = picker->moves;
       picker->end     = AddQuietCheckMoves(picker->current, board);
 
@@ -230,9 +296,13 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
 
     // QSearch Evasion Steps
     case QS_EVASION_HASH_MOVE:
+      StatsInc(picker->thread, mpEvasions);
       picker->phase = QS_EVASION_GEN_NOISY;
-      if (IsPseudoLegal(picker->hashMove, board))
+      if (IsPseudoLegal(picker->hashMove, board)) {
+        StatsInc(picker->thread, hashMoves);
         return picker->hashMove;
+      } else if (picker->hashMove)
+        StatsInc(picker->thread, hashMovesIllegal);
       // fallthrough
     case QS_EVASION_GEN_NOISY:
       picker->current = picker->moves;
@@ -245,7 +315,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case QS_EVASION_PLAY_NOISY:
       while (picker->current != picker->end) {
-        Move move = Best(picker->current++, picker->end);
+        Move move = Pick(picker);
 
         if (move != picker->hashMove)
           return move;
@@ -256,6 +326,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case QS_EVASION_GEN_QUIET:
       if (!skipQuiets) {
+        StatsInc(picker->thread, mpEvasionQuiets);
         picker->current = picker->moves;
         picker->end     = AddQuietMoves(picker->current, board);
 
@@ -267,7 +338,7 @@ Move NextMove(MovePicker* picker, Board* board, int skipQuiets) {
       // fallthrough
     case QS_EVASION_PLAY_QUIET:
       while (picker->current != picker->end && !skipQuiets) {
-        Move move = Best(picker->current++, picker->end);
+        Move move = Pick(picker);
 
         if (move != picker->hashMove)
           return move;
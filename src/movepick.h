@@ -30,8 +30,11 @@ enum {
   ST_MVV
 };
 
-INLINE void InitNormalMovePicker(MovePicker* picker, Move hashMove, ThreadData* thread, SearchStack* ss) {
+extern int PARTIAL_SORT;
+
+INLINE void InitNormalMovePicker(MovePicker* picker, Move hashMove, ThreadData* thread, SearchStack* ss, int depth) {
   picker->phase = HASH_MOVE;
+  picker->depth = depth;
 
   picker->hashMove = hashMove;
   picker->killer1  = ss->killers[0];
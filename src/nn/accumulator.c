@@ -26,18 +26,23 @@
 #include "../movegen.h"
 #include "../util.h"
 
-void ResetRefreshTable(AccumulatorKingState* refreshTable) {
+void ResetRefreshTable(const Network* net, AccumulatorKingState* refreshTable) {
   for (size_t b = 0; b < 2 * 2 * N_KING_BUCKETS; b++) {
     AccumulatorKingState* state = refreshTable + b;
 
-    memcpy(state->values, INPUT_BIASES, sizeof(acc_t) * N_HIDDEN);
+    memcpy(state->values, net->inputBiases, sizeof(acc_t) * net->hidden);
     memset(state->pcs, 0, sizeof(BitBoard) * 12);
   }
 }
 
 // Refreshes an accumulator using a diff from the last known board state
-// with proper king bucketing
-void RefreshAccumulator(Accumulator* dest, Board* board, const int perspective) {
+// with proper king bucketing, returning the number of features applied
+INLINE int RefreshAccumulatorHidden(const size_t hidden,
+                                    const Network* net,
+                                    Accumulator* dest,
+                                    AccumulatorKingState* refreshTable,
+                                    Board* board,
+                                    const int perspective) {
   Delta delta[1];
   delta->r = delta->a = 0;
 
@@ -45,7 +50,7 @@ void RefreshAccumulator(Accumulator* dest, Board* board, const int perspective)
   int pBucket    = perspective == WHITE ? 0 : 2 * N_KING_BUCKETS;
   int kingBucket = KING_BUCKETS[kingSq ^ (56 * perspective)] + N_KING_BUCKETS * (File(kingSq) > 3);
 
-  AccumulatorKingState* state = &board->refreshTable[pBucket + kingBucket];
+  AccumulatorKingState* state = &refreshTable[pBucket + kingBucket];
 
   for (int pc = WHITE_PAWN; pc <= BLACK_KING; pc++) {
     BitBoard curr = board->pieces[pc];
@@ -67,15 +72,26 @@ void RefreshAccumulator(Accumulator* dest, Board* board, const int perspective)
     state->pcs[pc] = curr;
   }
 
-  ApplyDelta(state->values, state->values, delta);
+  // Update the entry and copy it out in a single pass
+  if (delta->r + delta->a)
+    ApplyDeltaAndCopy(hidden, net, state->values, dest->values[perspective], delta);
+  else
+    memcpy(dest->values[perspective], state->values, sizeof(acc_t) * hidden);
 
-  // Copy in state
-  memcpy(dest->values[perspective], state->values, sizeof(acc_t) * N_HIDDEN);
   dest->correct[perspective] = 1;
+  return delta->r + delta->a;
+}
+
+int RefreshAccumulator(const Network* net,
+                       Accumulator* dest,
+                       AccumulatorKingState* refreshTable,
+                       Board* board,
+                       const int perspective) {
+  return SPECIALIZE_HIDDEN(net, RefreshAccumulatorHidden, dest, refreshTable, board, perspective);
 }
 
 // Resets an accumulator from pieces on the board
-void ResetAccumulator(Accumulator* dest, Board* board, const int perspective) {
+void ResetAccumulator(const Network* net, Accumulator* dest, Board* board, const int perspective) {
   Delta delta[1];
   delta->r = delta->a = 0;
 
@@ -89,12 +105,19 @@ void ResetAccumulator(Accumulator* dest, Board* board, const int perspective) {
   }
 
   acc_t* values = dest->values[perspective];
-  memcpy(values, INPUT_BIASES, sizeof(acc_t) * N_HIDDEN);
-  ApplyDelta(values, values, delta);
+  memcpy(values, net->inputBiases, sizeof(acc_t) * net->hidden);
+  ApplyDelta(net->hidden, net, values, values, delta);
   dest->correct[perspective] = 1;
 }
 
-void ApplyUpdates(acc_t* output, acc_t* prev, Board* board, const Move move, const int captured, const int view) {
+INLINE void ApplyUpdates(const size_t hidden,
+                         const Network* net,
+                         acc_t* output,
+                         acc_t* prev,
+                         Board* board,
+                         const Move move,
+                         const int captured,
+                         const int view) {
   const int king       = LSB(PieceBB(KING, view));
   const int movingSide = Moving(move) & 1;
 
@@ -105,26 +128,100 @@ void ApplyUpdates(acc_t* output, acc_t* prev, Board* board, const Move move, con
     int rookFrom = FeatureIdx(Piece(ROOK, movingSide), board->cr[CASTLING_ROOK[To(move)]], king, view);
     int rookTo   = FeatureIdx(Piece(ROOK, movingSide), CASTLE_ROOK_DEST[To(move)], king, view);
 
-    ApplySubSubAddAdd(output, prev, from, rookFrom, to, rookTo);
+    ApplySubSubAddAdd(hidden, net, output, prev, from, rookFrom, to, rookTo);
   } else if (IsCap(move)) {
     int capSq      = IsEP(move) ? To(move) - PawnDir(movingSide) : To(move);
     int capturedTo = FeatureIdx(captured, capSq, king, view);
 
-    ApplySubSubAdd(output, prev, from, capturedTo, to);
+    ApplySubSubAdd(hidden, net, output, prev, from, capturedTo, to);
   } else {
-    ApplySubAdd(output, prev, from, to);
+    ApplySubAdd(hidden, net, output, prev, from, to);
   }
 }
 
-void ApplyLazyUpdates(Accumulator* live, Board* board, const int view) {
+// Adds the features changed by a move to a delta, cancelling any feature that
+// an earlier move in the same delta added (or removed)
+INLINE void AddMoveDelta(Delta* delta, Board* board, const Move move, const int captured, const int view) {
+  const int king       = LSB(PieceBB(KING, view));
+  const int movingSide = Moving(move) & 1;
+
+  int rem[2], add[2];
+  int r = 0, a = 0;
+
+  rem[r++] = FeatureIdx(Moving(move), From(move), king, view);
+  add[a++] = FeatureIdx(IsPromo(move) ? PromoPiece(move, movingSide) : Moving(move), To(move), king, view);
+
+  if (IsCas(move)) {
+    rem[r++] = FeatureIdx(Piece(ROOK, movingSide), board->cr[CASTLING_ROOK[To(move)]], king, view);
+    add[a++] = FeatureIdx(Piece(ROOK, movingSide), CASTLE_ROOK_DEST[To(move)], king, view);
+  } else if (IsCap(move)) {
+    int capSq = IsEP(move) ? To(move) - PawnDir(movingSide) : To(move);
+    rem[r++]  = FeatureIdx(captured, capSq, king, view);
+  }
+
+  for (int i = 0; i < r; i++) {
+    int j = 0;
+    while (j < delta->a && delta->add[j] != rem[i])
+      j++;
+
+    if (j < delta->a)
+      delta->add[j] = delta->add[--delta->a];
+    else
+      delta->rem[delta->r++] = rem[i];
+  }
+
+  for (int i = 0; i < a; i++) {
+    int j = 0;
+    while (j < delta->r && delta->rem[j] != add[i])
+      j++;
+
+    if (j < delta->r)
+      delta->rem[j] = delta->rem[--delta->r];
+    else
+      delta->add[delta->a++] = add[i];
+  }
+}
+
+// Returns the number of plies that were updated
+INLINE int ApplyLazyUpdatesHidden(const size_t hidden,
+                                  const Network* net,
+                                  Accumulator* live,
+                                  Board* board,
+                                  const int view) {
   Accumulator* curr = live;
   while (!(--curr)->correct[view])
     ; // go back to the latest correct accumulator
 
+  const int plies = live - curr;
+
+  // Several stale plies are fused into a single pass that skips the
+  // intermediate accumulators. Only the parent is written, as the one
+  // its other children (and so a later update) will start from.
+  if (plies > 1 && plies <= MAX_FUSED_PLIES) {
+    Delta path[1], last[1];
+    path->r = path->a = last->r = last->a = 0;
+
+    Accumulator* parent = live - 1;
+    for (Accumulator* acc = curr; acc != parent; acc++)
+      AddMoveDelta(path, board, acc->move, acc->captured, view);
+    AddMoveDelta(last, board, parent->move, parent->captured, view);
+
+    ApplyDeltaPath(hidden, net, live->values[view], parent->values[view], curr->values[view], path, last);
+    parent->correct[view] = live->correct[view] = 1;
+
+    return plies;
+  }
+
   do {
-    ApplyUpdates((curr + 1)->values[view], curr->values[view], board, curr->move, curr->captured, view);
+    ApplyUpdates(hidden, net, (curr + 1)->values[view], curr->values[view], board, curr->move, curr->captured, view);
     (curr + 1)->correct[view] = 1;
   } while (++curr != live);
+
+  return plies;
+}
+
+int ApplyLazyUpdates(const Network* net, Accumulator* live, Board* board, const int view) {
+  return SPECIALIZE_HIDDEN(net, ApplyLazyUpdatesHidden, live, board, view);
 }
 
 int CanEfficientlyUpdate(Accumulator* live, const int view) {
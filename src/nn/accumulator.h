@@ -17,30 +17,42 @@
 #ifndef ACCUMULATOR_H
 #define ACCUMULATOR_H
 
+#include "../bits.h"
 #include "../board.h"
+#include "../move.h"
 #include "../types.h"
 #include "../util.h"
 
 #if defined(__AVX512F__) && defined(__AVX512BW__)
 #include <immintrin.h>
-#define UNROLL     512
-#define NUM_REGS   16
-#define regi_t     __m512i
-#define regi_load  _mm512_load_si512
-#define regi_sub   _mm512_sub_epi16
-#define regi_add   _mm512_add_epi16
-#define regi_store _mm512_store_si512
+#define UNROLL        512
+#define NUM_REGS      16
+#define regi_t        __m512i
+#define regi_load     _mm512_load_si512
+#define regi_sub      _mm512_sub_epi16
+#define regi_add      _mm512_add_epi16
+#define regi_store    _mm512_store_si512
+#define regi_mullo    _mm512_mullo_epi16
+#define regi_widen(a) _mm512_cvtepi8_epi16(_mm256_load_si256((const __m256i*) (a)))
 #elif defined(__AVX2__)
 #include <immintrin.h>
-#define UNROLL     256
-#define NUM_REGS   16
-#define regi_t     __m256i
-#define regi_load  _mm256_load_si256
-#define regi_sub   _mm256_sub_epi16
-#define regi_add   _mm256_add_epi16
-#define regi_store _mm256_store_si256
+#define UNROLL        256
+#define NUM_REGS      16
+#define regi_t        __m256i
+#define regi_load     _mm256_load_si256
+#define regi_sub      _mm256_sub_epi16
+#define regi_add      _mm256_add_epi16
+#define regi_store    _mm256_store_si256
+#define regi_mullo    _mm256_mullo_epi16
+#define regi_widen(a) _mm256_cvtepi8_epi16(_mm_load_si128((const __m128i*) (a)))
 #elif defined(__SSE2__)
 #include <immintrin.h>
+// Sign extends 8 int8s without SSE4.1's cvtepi8
+INLINE __m128i m128_widen_epi8(const int8_t* a) {
+  const __m128i x = _mm_loadl_epi64((const __m128i*) a);
+  return _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8);
+}
+
 #define UNROLL     128
 #define NUM_REGS   16
 #define regi_t     __m128i
@@ -48,6 +60,19 @@
 #define regi_sub   _mm_sub_epi16
 #define regi_add   _mm_add_epi16
 #define regi_store _mm_store_si128
+#define regi_mullo _mm_mullo_epi16
+#define regi_widen m128_widen_epi8
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define UNROLL           128
+#define NUM_REGS         16
+#define regi_t           int16x8_t
+#define regi_load(a)     (*(a))
+#define regi_sub         vsubq_s16
+#define regi_add         vaddq_s16
+#define regi_store(a, b) (*(a) = (b))
+#define regi_mullo       vmulq_s16
+#define regi_widen(a)    vmovl_s8(vld1_s8(a))
 #else
 #define UNROLL           16
 #define NUM_REGS         16
@@ -56,10 +81,38 @@
 #define regi_sub(a, b)   ((a) - (b))
 #define regi_add(a, b)   ((a) + (b))
 #define regi_store(a, b) (*(a) = (b))
+#define regi_mullo(a, b) ((a) * (b))
+#define regi_widen(a)    (*(a))
 #endif
 
-extern int16_t INPUT_WEIGHTS[N_FEATURES * N_HIDDEN];
-extern int16_t INPUT_BIASES[N_HIDDEN];
+// Calls fn with the hidden size of a network as a constant first argument,
+// so that the kernels are specialized for each supported shape
+#define SPECIALIZE_HIDDEN(net, fn, ...)                                                                                \
+  ((net)->hidden == 512    ? fn(512, net, __VA_ARGS__)                                                                 \
+   : (net)->hidden == 1536 ? fn(1536, net, __VA_ARGS__)                                                                \
+                           : fn(1024, net, __VA_ARGS__))
+
+INLINE int IsSupportedHidden(const size_t hidden) {
+  return hidden == 512 || hidden == 1024 || hidden == 1536;
+}
+
+// Register i of the (widened and scaled) weights of a feature, within the chunk of the accumulator at unrollOffset
+INLINE regi_t FeatureWeights(const size_t hidden,
+                             const Network* net,
+                             const size_t feature,
+                             const size_t unrollOffset,
+                             const size_t i) {
+#if defined(NN_INT8)
+  const size_t lanes   = UNROLL / NUM_REGS;
+  const regi_t* scales = (regi_t*) &net->inputScales[unrollOffset];
+
+  return regi_mullo(regi_widen(&net->inputWeights[feature * hidden + unrollOffset + i * lanes]), regi_load(&scales[i]));
+#else
+  const regi_t* weights = (regi_t*) &net->inputWeights[feature * hidden + unrollOffset];
+
+  return regi_load(&weights[i]);
+#endif
+}
 
 typedef struct {
   uint8_t r, a;
@@ -67,10 +120,31 @@ typedef struct {
   int add[32];
 } Delta;
 
-INLINE void ApplyDelta(acc_t* dest, acc_t* src, Delta* delta) {
+// A move removes and adds at most 2 features each, so the combined delta of
+// the plies before the last one always fits
+#define MAX_FUSED_PLIES 16
+
+// Applies a delta to the registers holding one chunk of an accumulator
+INLINE void ApplyDeltaChunk(const size_t hidden,
+                            const Network* net,
+                            regi_t* regs,
+                            Delta* delta,
+                            const size_t unrollOffset) {
+  for (size_t r = 0; r < delta->r; r++) {
+    for (size_t i = 0; i < NUM_REGS; i++)
+      regs[i] = regi_sub(regs[i], FeatureWeights(hidden, net, delta->rem[r], unrollOffset, i));
+  }
+
+  for (size_t a = 0; a < delta->a; a++) {
+    for (size_t i = 0; i < NUM_REGS; i++)
+      regs[i] = regi_add(regs[i], FeatureWeights(hidden, net, delta->add[a], unrollOffset, i));
+  }
+}
+
+INLINE void ApplyDelta(const size_t hidden, const Network* net, acc_t* dest, acc_t* src, Delta* delta) {
   regi_t regs[NUM_REGS];
 
-  for (size_t c = 0; c < N_HIDDEN / UNROLL; ++c) {
+  for (size_t c = 0; c < hidden / UNROLL; ++c) {
     const size_t unrollOffset = c * UNROLL;
 
     const regi_t* inputs = (regi_t*) &src[unrollOffset];
@@ -79,29 +153,73 @@ INLINE void ApplyDelta(acc_t* dest, acc_t* src, Delta* delta) {
     for (size_t i = 0; i < NUM_REGS; i++)
       regs[i] = regi_load(&inputs[i]);
 
-    for (size_t r = 0; r < delta->r; r++) {
-      const size_t offset   = delta->rem[r] * N_HIDDEN + unrollOffset;
-      const regi_t* weights = (regi_t*) &INPUT_WEIGHTS[offset];
-      for (size_t i = 0; i < NUM_REGS; i++)
-        regs[i] = regi_sub(regs[i], weights[i]);
-    }
+    ApplyDeltaChunk(hidden, net, regs, delta, unrollOffset);
+
+    for (size_t i = 0; i < NUM_REGS; i++)
+      regi_store(&outputs[i], regs[i]);
+  }
+}
+
+// As ApplyDelta on the refresh table entry, storing the result to both the
+// entry and the accumulator in the same pass
+INLINE void ApplyDeltaAndCopy(const size_t hidden, const Network* net, acc_t* state, acc_t* copy, Delta* delta) {
+  regi_t regs[NUM_REGS];
+
+  for (size_t c = 0; c < hidden / UNROLL; ++c) {
+    const size_t unrollOffset = c * UNROLL;
+
+    regi_t* entry   = (regi_t*) &state[unrollOffset];
+    regi_t* outputs = (regi_t*) &copy[unrollOffset];
+
+    for (size_t i = 0; i < NUM_REGS; i++)
+      regs[i] = regi_load(&entry[i]);
+
+    ApplyDeltaChunk(hidden, net, regs, delta, unrollOffset);
 
-    for (size_t a = 0; a < delta->a; a++) {
-      const size_t offset   = delta->add[a] * N_HIDDEN + unrollOffset;
-      const regi_t* weights = (regi_t*) &INPUT_WEIGHTS[offset];
-      for (size_t i = 0; i < NUM_REGS; i++)
-        regs[i] = regi_add(regs[i], weights[i]);
+    for (size_t i = 0; i < NUM_REGS; i++) {
+      regi_store(&entry[i], regs[i]);
+      regi_store(&outputs[i], regs[i]);
     }
+  }
+}
+
+// Applies the combined delta of several plies and then the delta of the last
+// ply in one pass, storing only the parent (mid) and the final accumulator
+INLINE void ApplyDeltaPath(const size_t hidden,
+                           const Network* net,
+                           acc_t* dest,
+                           acc_t* mid,
+                           acc_t* src,
+                           Delta* path,
+                           Delta* last) {
+  regi_t regs[NUM_REGS];
+
+  for (size_t c = 0; c < hidden / UNROLL; ++c) {
+    const size_t unrollOffset = c * UNROLL;
+
+    const regi_t* inputs = (regi_t*) &src[unrollOffset];
+    regi_t* parents      = (regi_t*) &mid[unrollOffset];
+    regi_t* outputs      = (regi_t*) &dest[unrollOffset];
+
+    for (size_t i = 0; i < NUM_REGS; i++)
+      regs[i] = regi_load(&inputs[i]);
+
+    ApplyDeltaChunk(hidden, net, regs, path, unrollOffset);
+
+    for (size_t i = 0; i < NUM_REGS; i++)
+      regi_store(&parents[i], regs[i]);
+
+    ApplyDeltaChunk(hidden, net, regs, last, unrollOffset);
 
     for (size_t i = 0; i < NUM_REGS; i++)
       regi_store(&outputs[i], regs[i]);
   }
 }
 
-INLINE void ApplySubAdd(acc_t* dest, acc_t* src, int f1, int f2) {
+INLINE void ApplySubAdd(const size_t hidden, const Network* net, acc_t* dest, acc_t* src, int f1, int f2) {
   regi_t regs[NUM_REGS];
 
-  for (size_t c = 0; c < N_HIDDEN / UNROLL; ++c) {
+  for (size_t c = 0; c < hidden / UNROLL; ++c) {
     const size_t unrollOffset = c * UNROLL;
 
     const regi_t* inputs = (regi_t*) &src[unrollOffset];
@@ -110,25 +228,21 @@ INLINE void ApplySubAdd(acc_t* dest, acc_t* src, int f1, int f2) {
     for (size_t i = 0; i < NUM_REGS; i++)
       regs[i] = regi_load(&inputs[i]);
 
-    const size_t o1  = f1 * N_HIDDEN + unrollOffset;
-    const regi_t* w1 = (regi_t*) &INPUT_WEIGHTS[o1];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_sub(regs[i], w1[i]);
+      regs[i] = regi_sub(regs[i], FeatureWeights(hidden, net, f1, unrollOffset, i));
 
-    const size_t o2  = f2 * N_HIDDEN + unrollOffset;
-    const regi_t* w2 = (regi_t*) &INPUT_WEIGHTS[o2];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_add(regs[i], w2[i]);
+      regs[i] = regi_add(regs[i], FeatureWeights(hidden, net, f2, unrollOffset, i));
 
     for (size_t i = 0; i < NUM_REGS; i++)
       regi_store(&outputs[i], regs[i]);
   }
 }
 
-INLINE void ApplySubSubAdd(acc_t* dest, acc_t* src, int f1, int f2, int f3) {
+INLINE void ApplySubSubAdd(const size_t hidden, const Network* net, acc_t* dest, acc_t* src, int f1, int f2, int f3) {
   regi_t regs[NUM_REGS];
 
-  for (size_t c = 0; c < N_HIDDEN / UNROLL; ++c) {
+  for (size_t c = 0; c < hidden / UNROLL; ++c) {
     const size_t unrollOffset = c * UNROLL;
 
     const regi_t* inputs = (regi_t*) &src[unrollOffset];
@@ -137,30 +251,31 @@ INLINE void ApplySubSubAdd(acc_t* dest, acc_t* src, int f1, int f2, int f3) {
     for (size_t i = 0; i < NUM_REGS; i++)
       regs[i] = regi_load(&inputs[i]);
 
-    const size_t o1  = f1 * N_HIDDEN + unrollOffset;
-    const regi_t* w1 = (regi_t*) &INPUT_WEIGHTS[o1];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_sub(regs[i], w1[i]);
+      regs[i] = regi_sub(regs[i], FeatureWeights(hidden, net, f1, unrollOffset, i));
 
-    const size_t o2  = f2 * N_HIDDEN + unrollOffset;
-    const regi_t* w2 = (regi_t*) &INPUT_WEIGHTS[o2];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_sub(regs[i], w2[i]);
+      regs[i] = regi_sub(regs[i], FeatureWeights(hidden, net, f2, unrollOffset, i));
 
-    const size_t o3  = f3 * N_HIDDEN + unrollOffset;
-    const regi_t* w3 = (regi_t*) &INPUT_WEIGHTS[o3];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_add(regs[i], w3[i]);
+      regs[i] = regi_add(regs[i], FeatureWeights(hidden, net, f3, unrollOffset, i));
 
     for (size_t i = 0; i < NUM_REGS; i++)
       regi_store(&outputs[i], regs[i]);
   }
 }
 
-INLINE void ApplySubSubAddAdd(acc_t* dest, acc_t* src, int f1, int f2, int f3, int f4) {
+INLINE void ApplySubSubAddAdd(const size_t hidden,
+                              const Network* net,
+                              acc_t* dest,
+                              acc_t* src,
+                              int f1,
+                              int f2,
+                              int f3,
+                              int f4) {
   regi_t regs[NUM_REGS];
 
-  for (size_t c = 0; c < N_HIDDEN / UNROLL; ++c) {
+  for (size_t c = 0; c < hidden / UNROLL; ++c) {
     const size_t unrollOffset = c * UNROLL;
 
     const regi_t* inputs = (regi_t*) &src[unrollOffset];
@@ -169,40 +284,58 @@ INLINE void ApplySubSubAddAdd(acc_t* dest, acc_t* src, int f1, int f2, int f3, i
     for (size_t i = 0; i < NUM_REGS; i++)
       regs[i] = regi_load(&inputs[i]);
 
-    const size_t o1  = f1 * N_HIDDEN + unrollOffset;
-    const regi_t* w1 = (regi_t*) &INPUT_WEIGHTS[o1];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_sub(regs[i], w1[i]);
+      regs[i] = regi_sub(regs[i], FeatureWeights(hidden, net, f1, unrollOffset, i));
 
-    const size_t o2  = f2 * N_HIDDEN + unrollOffset;
-    const regi_t* w2 = (regi_t*) &INPUT_WEIGHTS[o2];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_sub(regs[i], w2[i]);
+      regs[i] = regi_sub(regs[i], FeatureWeights(hidden, net, f2, unrollOffset, i));
 
-    const size_t o3  = f3 * N_HIDDEN + unrollOffset;
-    const regi_t* w3 = (regi_t*) &INPUT_WEIGHTS[o3];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_add(regs[i], w3[i]);
+      regs[i] = regi_add(regs[i], FeatureWeights(hidden, net, f3, unrollOffset, i));
 
-    const size_t o4  = f4 * N_HIDDEN + unrollOffset;
-    const regi_t* w4 = (regi_t*) &INPUT_WEIGHTS[o4];
     for (size_t i = 0; i < NUM_REGS; i++)
-      regs[i] = regi_add(regs[i], w4[i]);
+      regs[i] = regi_add(regs[i], FeatureWeights(hidden, net, f4, unrollOffset, i));
 
     for (size_t i = 0; i < NUM_REGS; i++)
       regi_store(&outputs[i], regs[i]);
   }
 }
 
-void ResetRefreshTable(AccumulatorKingState* refreshTable);
-void RefreshAccumulator(Accumulator* dest, Board* board, const int perspective);
+// Start loading the input weights rows that a move's accumulator update
+// adds and removes, for both views. Only the first line of each row, the
+// hardware prefetcher follows the rest once the update streams through it.
+// King moves are skipped, they can turn into a refresh.
+INLINE void PrefetchMoveFeatures(const Network* net, Board* board, const Move move) {
+  const int moving = Moving(move);
+  if (PieceType(moving) == KING)
+    return;
+
+  const int movingSide = moving & 1;
+  const int from       = From(move);
+  const int to         = To(move);
+  const int added      = IsPromo(move) ? PromoPiece(move, movingSide) : moving;
+  const int captured   = board->squares[to];
+
+  for (int view = WHITE; view <= BLACK; view++) {
+    const int king = LSB(PieceBB(KING, view));
+
+    __builtin_prefetch(&net->inputWeights[FeatureIdx(moving, from, king, view) * net->hidden]);
+    __builtin_prefetch(&net->inputWeights[FeatureIdx(added, to, king, view) * net->hidden]);
+    if (captured != NO_PIECE)
+      __builtin_prefetch(&net->inputWeights[FeatureIdx(captured, to, king, view) * net->hidden]);
+  }
+}
 
-void ResetAccumulator(Accumulator* dest, Board* board, const int perspective);
+void ResetRefreshTable(const Network* net, AccumulatorKingState* refreshTable);
+int RefreshAccumulator(const Network* net,
+                       Accumulator* dest,
+                       AccumulatorKingState* refreshTable,
+                       Board* board,
+                       const int perspective);
 
-void ApplyLazyUpdates(Accumulator* live, Board* board, const int view);
-int CanEfficientlyUpdate(Accumulator* live, const int view);
+void ResetAccumulator(const Network* net, Accumulator* dest, Board* board, const int perspective);
 
-void LoadDefaultNN();
-int LoadNetwork(char* path);
+int ApplyLazyUpdates(const Network* net, Accumulator* live, Board* board, const int view);
+int CanEfficientlyUpdate(Accumulator* live, const int view);
 
 #endif
@@ -20,6 +20,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "../bits.h"
 #include "../board.h"
 #include "../move.h"
@@ -32,32 +39,28 @@
 #define INCBIN_STYLE INCBIN_STYLE_CAMEL
 #include "../incbin.h"
 
+#if defined(FAT_MAIN)
+// Embedded once for all variants by the launcher, see fat.c
+extern const unsigned char EmbedData[];
+#else
 INCBIN(Embed, EVALFILE);
+#endif
 
-int16_t INPUT_WEIGHTS[N_FEATURES * N_HIDDEN] ALIGN;
-int16_t INPUT_BIASES[N_HIDDEN] ALIGN;
-
-int8_t L1_WEIGHTS[N_L1 * N_L2] ALIGN;
-int32_t L1_BIASES[N_L2] ALIGN;
-
-float L2_WEIGHTS[N_L2 * N_L3] ALIGN;
-float L2_BIASES[N_L3] ALIGN;
-
-float OUTPUT_WEIGHTS[N_L3 * N_OUTPUT] ALIGN;
-float OUTPUT_BIAS;
+Network NETWORK;
+Network SMALL_NETWORK;
 
 uint16_t LOOKUP_INDICES[256][8] ALIGN;
 
 #if defined(__AVX512F__) && defined(__AVX512BW__)
 #include <immintrin.h>
-INLINE void InputReLU(int8_t* outputs, Accumulator* acc, const int stm) {
+INLINE void InputReLU(const size_t hidden, int8_t* outputs, Accumulator* acc, const int stm) {
   const size_t WIDTH  = sizeof(__m512i) / sizeof(acc_t);
-  const size_t CHUNKS = N_HIDDEN / WIDTH;
+  const size_t CHUNKS = hidden / WIDTH;
   const int views[2]  = {stm, !stm};
 
   for (int v = 0; v < 2; v++) {
     const __m512i* in = (__m512i*) acc->values[views[v]];
-    __m512i* out      = (__m512i*) &outputs[N_HIDDEN * v];
+    __m512i* out      = (__m512i*) &outputs[hidden * v];
 
     for (size_t i = 0; i < CHUNKS / 2; i += 2) {
       __m512i s0 = _mm512_srai_epi16(in[2 * i + 0], 5);
@@ -72,14 +75,14 @@ INLINE void InputReLU(int8_t* outputs, Accumulator* acc, const int stm) {
 }
 #elif defined(__AVX2__)
 #include <immintrin.h>
-INLINE void InputReLU(int8_t* outputs, Accumulator* acc, const int stm) {
+INLINE void InputReLU(const size_t hidden, int8_t* outputs, Accumulator* acc, const int stm) {
   const size_t WIDTH  = sizeof(__m256i) / sizeof(acc_t);
-  const size_t CHUNKS = N_HIDDEN / WIDTH;
+  const size_t CHUNKS = hidden / WIDTH;
   const int views[2]  = {stm, !stm};
 
   for (int v = 0; v < 2; v++) {
     const __m256i* in = (__m256i*) acc->values[views[v]];
-    __m256i* out      = (__m256i*) &outputs[N_HIDDEN * v];
+    __m256i* out      = (__m256i*) &outputs[hidden * v];
 
     for (size_t i = 0; i < CHUNKS / 2; i += 2) {
       __m256i s0 = _mm256_srai_epi16(in[2 * i + 0], 5);
@@ -94,16 +97,16 @@ INLINE void InputReLU(int8_t* outputs, Accumulator* acc, const int stm) {
 }
 #elif defined(__SSE2__)
 #include <immintrin.h>
-INLINE void InputReLU(int8_t* outputs, Accumulator* acc, const int stm) {
+INLINE void InputReLU(const size_t hidden, int8_t* outputs, Accumulator* acc, const int stm) {
   const size_t WIDTH  = sizeof(__m128i) / sizeof(acc_t);
-  const size_t CHUNKS = N_HIDDEN / WIDTH;
+  const size_t CHUNKS = hidden / WIDTH;
   const int views[2]  = {stm, !stm};
 
   const __m128i k0x80s = _mm_set1_epi8(-128);
 
   for (int v = 0; v < 2; v++) {
     const __m128i* in = (__m128i*) acc->values[views[v]];
-    __m128i* out      = (__m128i*) &outputs[N_HIDDEN * v];
+    __m128i* out      = (__m128i*) &outputs[hidden * v];
 
     for (size_t i = 0; i < CHUNKS / 2; i++) {
       __m128i s0 = _mm_srai_epi16(in[2 * i + 0], 5);
@@ -113,22 +116,53 @@ INLINE void InputReLU(int8_t* outputs, Accumulator* acc, const int stm) {
     }
   }
 }
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+INLINE void InputReLU(const size_t hidden, int8_t* outputs, Accumulator* acc, const int stm) {
+  const size_t WIDTH  = sizeof(int16x8_t) / sizeof(acc_t);
+  const size_t CHUNKS = hidden / WIDTH;
+  const int views[2]  = {stm, !stm};
+
+  for (int v = 0; v < 2; v++) {
+    const int16x8_t* in = (int16x8_t*) acc->values[views[v]];
+    int8x16_t* out      = (int8x16_t*) &outputs[hidden * v];
+
+    for (size_t i = 0; i < CHUNKS / 2; i++) {
+      int16x8_t s0 = vshrq_n_s16(in[2 * i + 0], 5);
+      int16x8_t s1 = vshrq_n_s16(in[2 * i + 1], 5);
+
+      out[i] = vmaxq_s8(vcombine_s8(vqmovn_s16(s0), vqmovn_s16(s1)), vdupq_n_s8(0));
+    }
+  }
+}
 #else
-INLINE void InputReLU(int8_t* outputs, Accumulator* acc, const int stm) {
+INLINE void InputReLU(const size_t hidden, int8_t* outputs, Accumulator* acc, const int stm) {
   const int views[2] = {stm, !stm};
   const int max      = 127 << 5;
 
   for (int v = 0; v < 2; v++) {
     const acc_t* in = acc->values[views[v]];
-    int8_t* out     = &outputs[N_HIDDEN * v];
+    int8_t* out     = &outputs[hidden * v];
 
-    for (size_t i = 0; i < N_HIDDEN; i++)
+    for (size_t i = 0; i < hidden; i++)
       out[i] = Min(max, Max(0, in[i])) >> 5;
   }
 }
 #endif
 
 #if defined(__AVX512F__) && defined(__AVX512BW__)
+#if defined(__AVX512VNNI__)
+INLINE void m512_add_dpbusd_epi32(__m512i* acc, __m512i a, __m512i b) {
+  *acc = _mm512_dpbusd_epi32(*acc, a, b);
+}
+
+// Summed apart from acc, which keeps the dependency chain through acc short
+INLINE void m512_add_dpbusd_epi32x2(__m512i* acc, __m512i a0, __m512i b0, __m512i a1, __m512i b1) {
+  __m512i p0 = _mm512_dpbusd_epi32(_mm512_setzero_si512(), a0, b0);
+  p0         = _mm512_dpbusd_epi32(p0, a1, b1);
+  *acc       = _mm512_add_epi32(*acc, p0);
+}
+#else
 INLINE void m512_add_dpbusd_epi32(__m512i* acc, __m512i a, __m512i b) {
   __m512i p0 = _mm512_maddubs_epi16(a, b);
   p0         = _mm512_madd_epi16(p0, _mm512_set1_epi16(1));
@@ -142,6 +176,7 @@ INLINE void m512_add_dpbusd_epi32x2(__m512i* acc, __m512i a0, __m512i b0, __m512
   p0   = _mm512_madd_epi16(_mm512_add_epi16(p0, p1), _mm512_set1_epi16(1));
   *acc = _mm512_add_epi32(*acc, p0);
 }
+#endif
 
 INLINE uint32_t NNZ(__m512i chunk) {
   return _mm512_cmpgt_epi32_mask(chunk, _mm512_setzero_si512());
@@ -181,13 +216,13 @@ INLINE size_t FindNNZ(uint16_t* dest, const int32_t* inputs, const size_t chunks
   return count;
 }
 
-INLINE void L1AffineReLU(float* dest, int8_t* src) {
+INLINE void L1AffineReLU(const size_t hidden, const Network* net, float* dest, int8_t* src) {
   const size_t OUT_WIDTH  = sizeof(__m512i) / sizeof(int32_t);
-  const size_t NUM_CHUNKS = N_L1 / SPARSE_CHUNK_SIZE;
+  const size_t NUM_CHUNKS = 2 * hidden / SPARSE_CHUNK_SIZE;
   const size_t OUT_CC     = N_L2 / OUT_WIDTH;
 
   const int32_t* in32   = (int32_t*) src;
-  const __m512i* biases = (__m512i*) L1_BIASES;
+  const __m512i* biases = (__m512i*) net->l1Biases;
   __m512* out           = (__m512*) dest;
 
   uint16_t nnz[NUM_CHUNKS];
@@ -205,8 +240,8 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
     const __m512i f0 = _mm512_set1_epi32(in32[i0]);
     const __m512i f1 = _mm512_set1_epi32(in32[i1]);
 
-    const __m512i* c0 = (__m512i*) &L1_WEIGHTS[i0 * N_L2 * SPARSE_CHUNK_SIZE];
-    const __m512i* c1 = (__m512i*) &L1_WEIGHTS[i1 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m512i* c0 = (__m512i*) &net->l1Weights[i0 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m512i* c1 = (__m512i*) &net->l1Weights[i1 * N_L2 * SPARSE_CHUNK_SIZE];
 
     for (size_t j = 0; j < OUT_CC; j++)
       m512_add_dpbusd_epi32x2(regs + j, f0, c0[j], f1, c1[j]);
@@ -215,7 +250,7 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
   if (i < count) {
     const uint16_t i0 = nnz[i];
     const __m512i f0  = _mm512_set1_epi32(in32[i0]);
-    const __m512i* c0 = (__m512i*) &L1_WEIGHTS[i0 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m512i* c0 = (__m512i*) &net->l1Weights[i0 * N_L2 * SPARSE_CHUNK_SIZE];
 
     for (size_t j = 0; j < OUT_CC; j++)
       m512_add_dpbusd_epi32(regs + j, f0, c0[j]);
@@ -225,6 +260,18 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
     out[i] = _mm512_cvtepi32_ps(_mm512_max_epi32(regs[i], _mm512_setzero_si512()));
 }
 #elif defined(__AVX2__)
+#if defined(__AVXVNNI__)
+INLINE void m256_add_dpbusd_epi32(__m256i* acc, __m256i a, __m256i b) {
+  *acc = _mm256_dpbusd_avx_epi32(*acc, a, b);
+}
+
+// Summed apart from acc, which keeps the dependency chain through acc short
+INLINE void m256_add_dpbusd_epi32x2(__m256i* acc, __m256i a0, __m256i b0, __m256i a1, __m256i b1) {
+  __m256i p0 = _mm256_dpbusd_avx_epi32(_mm256_setzero_si256(), a0, b0);
+  p0         = _mm256_dpbusd_avx_epi32(p0, a1, b1);
+  *acc       = _mm256_add_epi32(*acc, p0);
+}
+#else
 INLINE void m256_add_dpbusd_epi32(__m256i* acc, __m256i a, __m256i b) {
   __m256i p0 = _mm256_maddubs_epi16(a, b);
   p0         = _mm256_madd_epi16(p0, _mm256_set1_epi16(1));
@@ -238,6 +285,7 @@ INLINE void m256_add_dpbusd_epi32x2(__m256i* acc, __m256i a0, __m256i b0, __m256
   p0   = _mm256_madd_epi16(_mm256_add_epi16(p0, p1), _mm256_set1_epi16(1));
   *acc = _mm256_add_epi32(*acc, p0);
 }
+#endif
 
 INLINE uint32_t NNZ(__m256i chunk) {
   return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(chunk, _mm256_setzero_si256())));
@@ -277,13 +325,13 @@ INLINE size_t FindNNZ(uint16_t* dest, const int32_t* inputs, const size_t chunks
   return count;
 }
 
-INLINE void L1AffineReLU(float* dest, int8_t* src) {
+INLINE void L1AffineReLU(const size_t hidden, const Network* net, float* dest, int8_t* src) {
   const size_t OUT_WIDTH  = sizeof(__m256i) / sizeof(int32_t);
-  const size_t NUM_CHUNKS = N_L1 / SPARSE_CHUNK_SIZE;
+  const size_t NUM_CHUNKS = 2 * hidden / SPARSE_CHUNK_SIZE;
   const size_t OUT_CC     = N_L2 / OUT_WIDTH;
 
   const int32_t* in32   = (int32_t*) src;
-  const __m256i* biases = (__m256i*) L1_BIASES;
+  const __m256i* biases = (__m256i*) net->l1Biases;
   __m256* out           = (__m256*) dest;
 
   uint16_t nnz[NUM_CHUNKS];
@@ -301,8 +349,8 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
     const __m256i f0 = _mm256_set1_epi32(in32[i0]);
     const __m256i f1 = _mm256_set1_epi32(in32[i1]);
 
-    const __m256i* c0 = (__m256i*) &L1_WEIGHTS[i0 * N_L2 * SPARSE_CHUNK_SIZE];
-    const __m256i* c1 = (__m256i*) &L1_WEIGHTS[i1 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m256i* c0 = (__m256i*) &net->l1Weights[i0 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m256i* c1 = (__m256i*) &net->l1Weights[i1 * N_L2 * SPARSE_CHUNK_SIZE];
 
     for (size_t j = 0; j < OUT_CC; j++)
       m256_add_dpbusd_epi32x2(regs + j, f0, c0[j], f1, c1[j]);
@@ -311,7 +359,7 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
   if (i < count) {
     const uint16_t i0 = nnz[i];
     const __m256i f0  = _mm256_set1_epi32(in32[i0]);
-    const __m256i* c0 = (__m256i*) &L1_WEIGHTS[i0 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m256i* c0 = (__m256i*) &net->l1Weights[i0 * N_L2 * SPARSE_CHUNK_SIZE];
 
     for (size_t j = 0; j < OUT_CC; j++)
       m256_add_dpbusd_epi32(regs + j, f0, c0[j]);
@@ -374,13 +422,13 @@ INLINE size_t FindNNZ(uint16_t* dest, const int32_t* inputs, const size_t chunks
   return count;
 }
 
-INLINE void L1AffineReLU(float* dest, int8_t* src) {
+INLINE void L1AffineReLU(const size_t hidden, const Network* net, float* dest, int8_t* src) {
   const size_t OUT_WIDTH  = sizeof(__m128i) / sizeof(int32_t);
-  const size_t NUM_CHUNKS = N_L1 / SPARSE_CHUNK_SIZE;
+  const size_t NUM_CHUNKS = 2 * hidden / SPARSE_CHUNK_SIZE;
   const size_t OUT_CC     = N_L2 / OUT_WIDTH;
 
   const int32_t* in32   = (int32_t*) src;
-  const __m128i* biases = (__m128i*) L1_BIASES;
+  const __m128i* biases = (__m128i*) net->l1Biases;
   __m128* out           = (__m128*) dest;
 
   uint16_t nnz[NUM_CHUNKS];
@@ -398,8 +446,8 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
     const __m128i f0 = _mm_set1_epi32(in32[i0]);
     const __m128i f1 = _mm_set1_epi32(in32[i1]);
 
-    const __m128i* c0 = (__m128i*) &L1_WEIGHTS[i0 * N_L2 * SPARSE_CHUNK_SIZE];
-    const __m128i* c1 = (__m128i*) &L1_WEIGHTS[i1 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m128i* c0 = (__m128i*) &net->l1Weights[i0 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m128i* c1 = (__m128i*) &net->l1Weights[i1 * N_L2 * SPARSE_CHUNK_SIZE];
 
     for (size_t j = 0; j < OUT_CC; j++)
       m128_add_dpbusd_epi32x2(regs + j, f0, c0[j], f1, c1[j]);
@@ -408,7 +456,7 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
   if (i < count) {
     const uint16_t i0 = nnz[i];
     const __m128i f0  = _mm_set1_epi32(in32[i0]);
-    const __m128i* c0 = (__m128i*) &L1_WEIGHTS[i0 * N_L2 * SPARSE_CHUNK_SIZE];
+    const __m128i* c0 = (__m128i*) &net->l1Weights[i0 * N_L2 * SPARSE_CHUNK_SIZE];
 
     for (size_t j = 0; j < OUT_CC; j++)
       m128_add_dpbusd_epi32(regs + j, f0, c0[j]);
@@ -417,17 +465,99 @@ INLINE void L1AffineReLU(float* dest, int8_t* src) {
   for (i = 0; i < OUT_CC; i++)
     out[i] = _mm_max_ps(_mm_cvtepi32_ps(regs[i]), _mm_setzero_ps());
 }
+#elif defined(__ARM_NEON)
+// Inputs are within [0, 127] so a signed dot product gives the same result
+#if defined(__ARM_FEATURE_DOTPROD)
+INLINE void neon_add_dpbusd_s32(int32x4_t* acc, int8x16_t a, int8x16_t b) {
+  *acc = vdotq_s32(*acc, a, b);
+}
+#else
+INLINE void neon_add_dpbusd_s32(int32x4_t* acc, int8x16_t a, int8x16_t b) {
+  int16x8_t p0 = vmull_s8(vget_low_s8(a), vget_low_s8(b));
+  int16x8_t p1 = vmull_high_s8(a, b);
+  *acc         = vpadalq_s16(*acc, vpaddq_s16(p0, p1));
+}
+#endif
+
+INLINE uint32_t NNZ(int32x4_t chunk) {
+  static const uint32_t BITS[4] = {1, 2, 4, 8};
+
+  return vaddvq_u32(vandq_u32(vcgtq_s32(chunk, vdupq_n_s32(0)), vld1q_u32(BITS)));
+}
+
+INLINE size_t FindNNZ(uint16_t* dest, const int32_t* inputs, const size_t chunks) {
+  const size_t IN_WIDTH      = sizeof(int32x4_t) / sizeof(int32_t);
+  const size_t CHUNK_SIZE    = 8;
+  const size_t NUM_CHUNKS    = chunks / CHUNK_SIZE;
+  const size_t IN_PER_CHUNK  = CHUNK_SIZE / IN_WIDTH;
+  const size_t OUT_PER_CHUNK = CHUNK_SIZE / 8;
+
+  const int32x4_t* in = (int32x4_t*) inputs;
+
+  size_t count = 0;
+
+  const uint16x8_t increment = vdupq_n_u16(8);
+  uint16x8_t base            = vdupq_n_u16(0);
+
+  for (size_t i = 0; i < NUM_CHUNKS; i++) {
+    uint32_t nnz = 0;
+
+    for (size_t j = 0; j < IN_PER_CHUNK; j++) {
+      const int32x4_t inputChunk = in[i * IN_PER_CHUNK + j];
+      nnz |= NNZ(inputChunk) << (j * IN_WIDTH);
+    }
+
+    for (size_t j = 0; j < OUT_PER_CHUNK; j++) {
+      const uint16_t lookup    = (nnz >> (j * 8)) & 0xFF;
+      const uint16x8_t offsets = vld1q_u16(LOOKUP_INDICES[lookup]);
+      vst1q_u16(dest + count, vaddq_u16(base, offsets));
+      count += BitCount(lookup);
+      base = vaddq_u16(base, increment);
+    }
+  }
+
+  return count;
+}
+
+INLINE void L1AffineReLU(const size_t hidden, const Network* net, float* dest, int8_t* src) {
+  const size_t OUT_WIDTH  = sizeof(int32x4_t) / sizeof(int32_t);
+  const size_t NUM_CHUNKS = 2 * hidden / SPARSE_CHUNK_SIZE;
+  const size_t OUT_CC     = N_L2 / OUT_WIDTH;
+
+  const int32_t* in32     = (int32_t*) src;
+  const int32x4_t* biases = (int32x4_t*) net->l1Biases;
+  float32x4_t* out        = (float32x4_t*) dest;
+
+  uint16_t nnz[NUM_CHUNKS];
+  size_t count = FindNNZ(nnz, in32, NUM_CHUNKS);
+
+  int32x4_t regs[OUT_CC];
+  for (size_t i = 0; i < OUT_CC; i++)
+    regs[i] = biases[i];
+
+  for (size_t i = 0; i < count; i++) {
+    const uint16_t i0   = nnz[i];
+    const int8x16_t f0  = vreinterpretq_s8_s32(vdupq_n_s32(in32[i0]));
+    const int8x16_t* c0 = (int8x16_t*) &net->l1Weights[i0 * N_L2 * SPARSE_CHUNK_SIZE];
+
+    for (size_t j = 0; j < OUT_CC; j++)
+      neon_add_dpbusd_s32(regs + j, f0, c0[j]);
+  }
+
+  for (size_t i = 0; i < OUT_CC; i++)
+    out[i] = vcvtq_f32_s32(vmaxq_s32(regs[i], vdupq_n_s32(0)));
+}
 #else
-INLINE void L1AffineReLU(float* dest, int8_t* src) {
+INLINE void L1AffineReLU(const size_t hidden, const Network* net, float* dest, int8_t* src) {
   for (size_t i = 0; i < N_L2; i++)
-    dest[i] = L1_BIASES[i];
+    dest[i] = net->l1Biases[i];
 
-  for (size_t i = 0; i < N_L1; i++) {
+  for (size_t i = 0; i < 2 * hidden; i++) {
     if (!src[i])
       continue;
 
     for (size_t j = 0; j < N_L2; j++)
-      dest[j] += src[i] * L1_WEIGHTS[j * N_L1 + i];
+      dest[j] += src[i] * net->l1Weights[j * 2 * hidden + i];
   }
 
   for (size_t i = 0; i < N_L2; i++)
@@ -462,15 +592,15 @@ INLINE __m128 m512_hadd_psx4(__m512* regs) {
   return _mm_add_ps(sum128lo, sum128hi);
 }
 
-INLINE void L2AffineReLU(float* dest, float* src) {
+INLINE void L2AffineReLU(const Network* net, float* dest, float* src) {
   const size_t IN_WIDTH   = sizeof(__m512) / sizeof(float);
   const size_t IN_CHUNKS  = N_L2 / IN_WIDTH;
   const size_t OUT_CC     = 8; // 16 is possible, but slower.
   const size_t OUT_CHUNKS = N_L3 / OUT_CC;
 
   const __m512* in      = (__m512*) src;
-  const __m512* weights = (__m512*) L2_WEIGHTS;
-  const __m256* biases  = (__m256*) L2_BIASES;
+  const __m512* weights = (__m512*) net->l2Weights;
+  const __m256* biases  = (__m256*) net->l2Biases;
   __m256* out           = (__m256*) dest;
 
   __m512 regs[OUT_CC];
@@ -503,15 +633,15 @@ INLINE __m128 m256_hadd_psx4(__m256* regs) {
   return _mm_add_ps(sum128lo, sum128hi);
 }
 
-INLINE void L2AffineReLU(float* dest, float* src) {
+INLINE void L2AffineReLU(const Network* net, float* dest, float* src) {
   const size_t IN_WIDTH   = sizeof(__m256) / sizeof(float);
   const size_t IN_CHUNKS  = N_L2 / IN_WIDTH;
   const size_t OUT_CC     = 8;
   const size_t OUT_CHUNKS = N_L3 / OUT_CC;
 
   const __m256* in      = (__m256*) src;
-  const __m256* weights = (__m256*) L2_WEIGHTS;
-  const __m256* biases  = (__m256*) L2_BIASES;
+  const __m256* weights = (__m256*) net->l2Weights;
+  const __m256* biases  = (__m256*) net->l2Biases;
   __m256* out           = (__m256*) dest;
 
   __m256 regs[OUT_CC];
@@ -538,15 +668,15 @@ INLINE __m128 m128_hadd_psx4(__m128* regs) {
   return _mm_hadd_ps(regs[0], regs[2]);
 }
 
-INLINE void L2AffineReLU(float* dest, float* src) {
+INLINE void L2AffineReLU(const Network* net, float* dest, float* src) {
   const size_t IN_WIDTH   = sizeof(__m128) / sizeof(float);
   const size_t IN_CHUNKS  = N_L2 / IN_WIDTH;
   const size_t OUT_CC     = 4;
   const size_t OUT_CHUNKS = N_L3 / OUT_CC;
 
   const __m128* in      = (__m128*) src;
-  const __m128* weights = (__m128*) L2_WEIGHTS;
-  const __m128* biases  = (__m128*) L2_BIASES;
+  const __m128* weights = (__m128*) net->l2Weights;
+  const __m128* biases  = (__m128*) net->l2Biases;
   __m128* out           = (__m128*) dest;
 
   __m128 regs[OUT_CC];
@@ -563,14 +693,44 @@ INLINE void L2AffineReLU(float* dest, float* src) {
     out[i]           = _mm_max_ps(_mm_add_ps(sum, biases[i]), _mm_setzero_ps());
   }
 }
+#elif defined(__ARM_NEON)
+INLINE float32x4_t neon_hadd_f32x4(float32x4_t* regs) {
+  return vpaddq_f32(vpaddq_f32(regs[0], regs[1]), vpaddq_f32(regs[2], regs[3]));
+}
+
+INLINE void L2AffineReLU(const Network* net, float* dest, float* src) {
+  const size_t IN_WIDTH   = sizeof(float32x4_t) / sizeof(float);
+  const size_t IN_CHUNKS  = N_L2 / IN_WIDTH;
+  const size_t OUT_CC     = 4;
+  const size_t OUT_CHUNKS = N_L3 / OUT_CC;
+
+  const float32x4_t* in      = (float32x4_t*) src;
+  const float32x4_t* weights = (float32x4_t*) net->l2Weights;
+  const float32x4_t* biases  = (float32x4_t*) net->l2Biases;
+  float32x4_t* out           = (float32x4_t*) dest;
+
+  float32x4_t regs[OUT_CC];
+
+  for (size_t i = 0; i < OUT_CHUNKS; i++) {
+    for (size_t k = 0; k < OUT_CC; k++)
+      regs[k] = vdupq_n_f32(0);
+
+    for (size_t j = 0; j < IN_CHUNKS; j++)
+      for (size_t k = 0; k < OUT_CC; k++)
+        regs[k] = vfmaq_f32(regs[k], in[j], weights[j + IN_CHUNKS * (OUT_CC * i + k)]);
+
+    const float32x4_t sum = neon_hadd_f32x4(regs);
+    out[i]                = vmaxq_f32(vaddq_f32(sum, biases[i]), vdupq_n_f32(0));
+  }
+}
 #else
-INLINE void L2AffineReLU(float* dest, float* src) {
+INLINE void L2AffineReLU(const Network* net, float* dest, float* src) {
   for (int i = 0; i < N_L3; i++) {
     const int offset = i * N_L2;
 
-    dest[i] = L2_BIASES[i];
+    dest[i] = net->l2Biases[i];
     for (int j = 0; j < N_L2; j++)
-      dest[i] += src[j] * L2_WEIGHTS[offset + j];
+      dest[i] += src[j] * net->l2Weights[offset + j];
 
     dest[i] = Max(0, dest[i]);
   }
@@ -578,12 +738,12 @@ INLINE void L2AffineReLU(float* dest, float* src) {
 #endif
 
 #if defined(__AVX512F__) && defined(__AVX512BW__)
-INLINE int L3Transform(float* src) {
+INLINE int L3Transform(const Network* net, float* src) {
   const size_t WIDTH  = sizeof(__m512) / sizeof(float);
   const size_t CHUNKS = N_L3 / WIDTH;
 
   const __m512* in      = (__m512*) src;
-  const __m512* weights = (__m512*) OUTPUT_WEIGHTS;
+  const __m512* weights = (__m512*) net->outputWeights;
 
   __m512 a0 = _mm512_setzero_ps();
   for (size_t i = 0; i < CHUNKS; i++)
@@ -595,15 +755,15 @@ INLINE int L3Transform(float* src) {
   const __m128 a2 = _mm_add_ps(a4, _mm_movehl_ps(a4, a4));
   const __m128 a1 = _mm_add_ss(a2, _mm_shuffle_ps(a2, a2, 0x1));
 
-  return _mm_cvtss_f32(a1) + OUTPUT_BIAS;
+  return _mm_cvtss_f32(a1) + net->outputBias;
 }
 #elif defined(__AVX2__)
-INLINE int L3Transform(float* src) {
+INLINE int L3Transform(const Network* net, float* src) {
   const size_t WIDTH  = sizeof(__m256) / sizeof(float);
   const size_t CHUNKS = N_L3 / WIDTH;
 
   const __m256* in      = (__m256*) src;
-  const __m256* weights = (__m256*) OUTPUT_WEIGHTS;
+  const __m256* weights = (__m256*) net->outputWeights;
 
   __m256 a0 = _mm256_setzero_ps();
   for (size_t i = 0; i < CHUNKS; i++)
@@ -613,15 +773,15 @@ INLINE int L3Transform(float* src) {
   const __m128 a2 = _mm_add_ps(a4, _mm_movehl_ps(a4, a4));
   const __m128 a1 = _mm_add_ss(a2, _mm_shuffle_ps(a2, a2, 0x1));
 
-  return _mm_cvtss_f32(a1) + OUTPUT_BIAS;
+  return _mm_cvtss_f32(a1) + net->outputBias;
 }
 #elif defined(__SSE__)
-INLINE float L3Transform(float* src) {
+INLINE float L3Transform(const Network* net, float* src) {
   const size_t WIDTH  = sizeof(__m128) / sizeof(float);
   const size_t CHUNKS = N_L3 / WIDTH;
 
   const __m128* in      = (__m128*) src;
-  const __m128* weights = (__m128*) OUTPUT_WEIGHTS;
+  const __m128* weights = (__m128*) net->outputWeights;
 
   __m128 a0 = _mm_setzero_ps();
   for (size_t i = 0; i < CHUNKS; i++)
@@ -630,95 +790,292 @@ INLINE float L3Transform(float* src) {
   const __m128 a2 = _mm_add_ps(a0, _mm_movehl_ps(a0, a0));
   const __m128 a1 = _mm_add_ss(a2, _mm_shuffle_ps(a2, a2, 0x1));
 
-  return _mm_cvtss_f32(a1) + OUTPUT_BIAS;
+  return _mm_cvtss_f32(a1) + net->outputBias;
+}
+#elif defined(__ARM_NEON)
+INLINE float L3Transform(const Network* net, float* src) {
+  const size_t WIDTH  = sizeof(float32x4_t) / sizeof(float);
+  const size_t CHUNKS = N_L3 / WIDTH;
+
+  const float32x4_t* in      = (float32x4_t*) src;
+  const float32x4_t* weights = (float32x4_t*) net->outputWeights;
+
+  float32x4_t a0 = vdupq_n_f32(0);
+  for (size_t i = 0; i < CHUNKS; i++)
+    a0 = vfmaq_f32(a0, in[i], weights[i]);
+
+  return vaddvq_f32(a0) + net->outputBias;
 }
 #else
-INLINE float L3Transform(float* src) {
-  float result = OUTPUT_BIAS;
+INLINE float L3Transform(const Network* net, float* src) {
+  float result = net->outputBias;
 
   for (int i = 0; i < N_L3; i++)
-    result += src[i] * OUTPUT_WEIGHTS[i];
+    result += src[i] * net->outputWeights[i];
 
   return result;
 }
 #endif
 
-int Propagate(Accumulator* accumulator, const int stm) {
-  int8_t x0[N_L1] ALIGN;
+INLINE int PropagateHidden(const size_t hidden, const Network* net, Accumulator* accumulator, const int stm) {
+  int8_t x0[N_L1_MAX] ALIGN;
   float x1[N_L2] ALIGN;
   float x2[N_L3] ALIGN;
 
-  InputReLU(x0, accumulator, stm);
-  L1AffineReLU(x1, x0);
-  L2AffineReLU(x2, x1);
-  return L3Transform(x2) / 32;
+  InputReLU(hidden, x0, accumulator, stm);
+  L1AffineReLU(hidden, net, x1, x0);
+  L2AffineReLU(net, x2, x1);
+  return L3Transform(net, x2) / 32;
+}
+
+int Propagate(const Network* net, Accumulator* accumulator, const int stm) {
+  return SPECIALIZE_HIDDEN(net, PropagateHidden, accumulator, stm);
+}
+
+// Evaluate a batch of boards, each with its own accumulator but all sharing a
+// refresh table. Consecutive positions with the same king buckets (as with
+// positions from one game) only pay for the pieces that differ, and each layer
+// runs over the whole batch while its weights are still in cache.
+INLINE void PredictBatchHidden(const size_t hidden, const Network* net, Board* boards, int n, int* scores) {
+  int8_t x0[EVAL_BATCH_SIZE][N_L1_MAX] ALIGN;
+  float x1[EVAL_BATCH_SIZE][N_L2] ALIGN;
+  float x2[EVAL_BATCH_SIZE][N_L3] ALIGN;
+
+  for (int i = 0; i < n; i++) {
+    RefreshAccumulator(net, boards[i].accumulators, boards[i].refreshTable, &boards[i], WHITE);
+    RefreshAccumulator(net, boards[i].accumulators, boards[i].refreshTable, &boards[i], BLACK);
+  }
+
+  for (int i = 0; i < n; i++)
+    InputReLU(hidden, x0[i], boards[i].accumulators, boards[i].stm);
+  for (int i = 0; i < n; i++)
+    L1AffineReLU(hidden, net, x1[i], x0[i]);
+  for (int i = 0; i < n; i++)
+    L2AffineReLU(net, x2[i], x1[i]);
+  for (int i = 0; i < n; i++)
+    scores[i] = L3Transform(net, x2[i]) / 32;
+}
+
+void PredictBatch(Board* boards, int n, int* scores) {
+  SPECIALIZE_HIDDEN(&NETWORK, PredictBatchHidden, boards, n, scores);
 }
 
 int Predict(Board* board) {
-  ResetAccumulator(board->accumulators, board, WHITE);
-  ResetAccumulator(board->accumulators, board, BLACK);
+  ResetAccumulator(&NETWORK, board->accumulators, board, WHITE);
+  ResetAccumulator(&NETWORK, board->accumulators, board, BLACK);
 
-  return board->stm == WHITE ? Propagate(board->accumulators, WHITE) : Propagate(board->accumulators, BLACK);
+  return Propagate(&NETWORK, board->accumulators, board->stm);
 }
 
-const size_t NETWORK_SIZE = sizeof(int16_t) * N_FEATURES * N_HIDDEN + // input weights
-                            sizeof(int16_t) * N_HIDDEN +              // input biases
-                            sizeof(int8_t) * N_L1 * N_L2 +            // input biases
-                            sizeof(int32_t) * N_L2 +                  // input biases
-                            sizeof(float) * N_L2 * N_L3 +             // input biases
-                            sizeof(float) * N_L3 +                    // input biases
-                            sizeof(float) * N_L3 +                    // output weights
-                            sizeof(float);                            // output bias
+// Size of a network in the plain (trainer) format
+static size_t NetworkSize(const size_t hidden) {
+  return sizeof(int16_t) * N_FEATURES * hidden + // input weights
+         sizeof(int16_t) * hidden +              // input biases
+         sizeof(int8_t) * 2 * hidden * N_L2 +    // l1 weights
+         sizeof(int32_t) * N_L2 +                // l1 biases
+         sizeof(float) * N_L2 * N_L3 +           // l2 weights
+         sizeof(float) * N_L3 +                  // l2 biases
+         sizeof(float) * N_L3 +                  // output weights
+         sizeof(float);                          // output bias
+}
 
-INLINE int WeightIdxScrambled(int idx) {
-  return ((idx / SPARSE_CHUNK_SIZE) % (N_L1 / SPARSE_CHUNK_SIZE) * N_L2 * SPARSE_CHUNK_SIZE) +
-         (idx / N_L1 * SPARSE_CHUNK_SIZE) + (idx % SPARSE_CHUNK_SIZE);
+static size_t InputWeightsSize(const size_t hidden) {
+  return sizeof(weight_t) * N_FEATURES * hidden;
 }
 
-INLINE void CopyData(const unsigned char* in) {
+// The exported image holds the input weights as they are used, followed by the scales for int8
+static size_t ExportedSize(const size_t hidden) {
+#if defined(NN_INT8)
+  return NetworkSize(hidden) - sizeof(int16_t) * N_FEATURES * hidden + InputWeightsSize(hidden) +
+         sizeof(int16_t) * hidden;
+#else
+  return NetworkSize(hidden);
+#endif
+}
+
+// Networks may start with a page sized header describing their shape, which
+// is followed by either the plain network or the in memory image of the
+// weights (after all of the shuffling below) from ExportNetwork. Images can be
+// mapped and used in place, but are only valid for builds with the same SIMD
+// layout. Networks without a header are plain and N_HIDDEN_DEFAULT wide.
+#define NN_FILE_MAGIC   "BRSKNNUE"
+#define NN_FILE_VERSION 2
+#define NN_FILE_HEADER  4096
+
+enum {
+  NN_FORMAT_PLAIN,
+  NN_FORMAT_IMAGE
+};
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+#define NN_INPUT_LAYOUT 2
+#elif defined(__AVX2__)
+#define NN_INPUT_LAYOUT 1
+#else
+#define NN_INPUT_LAYOUT 0
+#endif
+
+#if defined(__SSSE3__) || defined(__ARM_NEON)
+#define NN_L1_LAYOUT 1
+#else
+#define NN_L1_LAYOUT 0
+#endif
+
+#if defined(NN_INT8)
+#define NN_WEIGHT_LAYOUT 1
+#else
+#define NN_WEIGHT_LAYOUT 0
+#endif
+
+#define NN_LAYOUT (NN_INPUT_LAYOUT | (NN_L1_LAYOUT << 4) | (NN_WEIGHT_LAYOUT << 8))
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t format;
+  uint32_t layout; // SIMD layout of an image
+  uint32_t features, hidden, l1, l2, l3;
+} NNFileHeader;
+
+static void NNFileHeaderInit(NNFileHeader* header, const uint32_t format, const size_t hidden) {
+  memset(header, 0, sizeof(NNFileHeader));
+  memcpy(header->magic, NN_FILE_MAGIC, sizeof(header->magic));
+  header->version  = NN_FILE_VERSION;
+  header->format   = format;
+  header->layout   = format == NN_FORMAT_IMAGE ? NN_LAYOUT : 0;
+  header->features = N_FEATURES;
+  header->hidden   = hidden;
+  header->l1       = 2 * hidden;
+  header->l2       = N_L2;
+  header->l3       = N_L3;
+}
+
+// Returns why the network described by a header can't be used by this build, if it can't
+static const char* IncompatibleHeader(const NNFileHeader* header) {
+  if (header->version != NN_FILE_VERSION)
+    return "has an unsupported format version";
+  if (header->format != NN_FORMAT_PLAIN && header->format != NN_FORMAT_IMAGE)
+    return "has an unknown format";
+  if (header->features != N_FEATURES || header->l1 != 2 * header->hidden || header->l2 != N_L2 || header->l3 != N_L3)
+    return "has an unsupported architecture";
+  if (!IsSupportedHidden(header->hidden))
+    return "has an unsupported hidden size (512, 1024 and 1536 are supported)";
+  if (header->format == NN_FORMAT_IMAGE && header->layout != NN_LAYOUT)
+    return "was not exported by a compatible build";
+
+  return NULL;
+}
+
+static void FreeInputWeights(Network* net) {
+  if (!net->mem)
+    return;
+
+#if !defined(_WIN32)
+  if (net->memPages == PAGES_FILE)
+    munmap(net->mem, net->memSize);
+  else
+#endif
+    LargePagesFree(net->mem, net->memSize, net->memPages);
+
+  net->mem          = NULL;
+  net->inputWeights = NULL;
+}
+
+INLINE int WeightIdxScrambled(const int l1, int idx) {
+  return ((idx / SPARSE_CHUNK_SIZE) % (l1 / SPARSE_CHUNK_SIZE) * N_L2 * SPARSE_CHUNK_SIZE) +
+         (idx / l1 * SPARSE_CHUNK_SIZE) + (idx % SPARSE_CHUNK_SIZE);
+}
+
+// Point the input weights at a private, writable copy
+static void AllocInputWeights(Network* net, const size_t hidden) {
+  if (net->mem && net->memPages != PAGES_FILE && net->memSize == InputWeightsSize(hidden))
+    return;
+
+  FreeInputWeights(net);
+
+  net->memSize      = InputWeightsSize(hidden);
+  net->mem          = LargePagesAlloc(net->memSize, &net->memPages);
+  net->inputWeights = net->mem;
+}
+
+#if defined(NN_INT8)
+// Quantize the (already shuffled) int16 weights of each hidden neuron to int8
+// with the smallest scale that fits, so that w ~= scale * q
+static void QuantizeInputWeights(Network* net, const int16_t* weights, const size_t hidden) {
+  int maxAbs[N_HIDDEN_MAX] = {0};
+
+  for (size_t f = 0; f < N_FEATURES; f++)
+    for (size_t i = 0; i < hidden; i++)
+      maxAbs[i] = Max(maxAbs[i], abs(weights[f * hidden + i]));
+
+  for (size_t i = 0; i < hidden; i++)
+    net->inputScales[i] = Max(1, (maxAbs[i] + 126) / 127);
+
+  for (size_t f = 0; f < N_FEATURES; f++) {
+    for (size_t i = 0; i < hidden; i++) {
+      const int w     = weights[f * hidden + i];
+      const int scale = net->inputScales[i];
+
+      net->inputWeights[f * hidden + i] = (w >= 0 ? w + scale / 2 : w - scale / 2) / scale;
+    }
+  }
+}
+#endif
+
+INLINE void CopyData(Network* net, const unsigned char* in, const size_t hidden) {
   size_t offset = 0;
 
+  AllocInputWeights(net, hidden);
+  net->hidden = hidden;
+
   // Alloc a chunk of memory for the L1 weights which we
   // cannot copy into the stack directly
-  int8_t* l1 = malloc(N_L1 * N_L2 * sizeof(int8_t));
+  int8_t* l1 = malloc(2 * hidden * N_L2 * sizeof(int8_t));
 
-  memcpy(INPUT_WEIGHTS, &in[offset], N_FEATURES * N_HIDDEN * sizeof(int16_t));
-  offset += N_FEATURES * N_HIDDEN * sizeof(int16_t);
-  memcpy(INPUT_BIASES, &in[offset], N_HIDDEN * sizeof(int16_t));
-  offset += N_HIDDEN * sizeof(int16_t);
+#if defined(NN_INT8)
+  // The int16 weights are shuffled in a staging copy and quantized afterwards
+  int16_t* inputWeights = AlignedMalloc(N_FEATURES * hidden * sizeof(int16_t), 64);
+#else
+  int16_t* inputWeights = net->inputWeights;
+#endif
 
-  memcpy(l1, &in[offset], N_L1 * N_L2 * sizeof(int8_t));
-  offset += N_L1 * N_L2 * sizeof(int8_t);
-  memcpy(L1_BIASES, &in[offset], N_L2 * sizeof(int32_t));
+  memcpy(inputWeights, &in[offset], N_FEATURES * hidden * sizeof(int16_t));
+  offset += N_FEATURES * hidden * sizeof(int16_t);
+  memcpy(net->inputBiases, &in[offset], hidden * sizeof(int16_t));
+  offset += hidden * sizeof(int16_t);
+
+  memcpy(l1, &in[offset], 2 * hidden * N_L2 * sizeof(int8_t));
+  offset += 2 * hidden * N_L2 * sizeof(int8_t);
+  memcpy(net->l1Biases, &in[offset], N_L2 * sizeof(int32_t));
   offset += N_L2 * sizeof(int32_t);
 
-  memcpy(L2_WEIGHTS, &in[offset], N_L2 * N_L3 * sizeof(float));
+  memcpy(net->l2Weights, &in[offset], N_L2 * N_L3 * sizeof(float));
   offset += N_L2 * N_L3 * sizeof(float);
-  memcpy(L2_BIASES, &in[offset], N_L3 * sizeof(float));
+  memcpy(net->l2Biases, &in[offset], N_L3 * sizeof(float));
   offset += N_L3 * sizeof(float);
 
-  memcpy(OUTPUT_WEIGHTS, &in[offset], N_L3 * N_OUTPUT * sizeof(float));
+  memcpy(net->outputWeights, &in[offset], N_L3 * N_OUTPUT * sizeof(float));
   offset += N_L3 * N_OUTPUT * sizeof(float);
-  memcpy(&OUTPUT_BIAS, &in[offset], sizeof(float));
+  memcpy(&net->outputBias, &in[offset], sizeof(float));
 
-#if defined(__SSSE3__)
+#if defined(__SSSE3__) || defined(__ARM_NEON)
   // Shuffle the L1 weights for sparse matmul
-  for (int i = 0; i < N_L1 * N_L2; i++)
-    L1_WEIGHTS[WeightIdxScrambled(i)] = l1[i];
+  for (size_t i = 0; i < 2 * hidden * N_L2; i++)
+    net->l1Weights[WeightIdxScrambled(2 * hidden, i)] = l1[i];
 #else
-  for (int i = 0; i < N_L1 * N_L2; i++)
-    L1_WEIGHTS[i] = l1[i];
+  for (size_t i = 0; i < 2 * hidden * N_L2; i++)
+    net->l1Weights[i] = l1[i];
 #endif
 
   free(l1);
 
 #if defined(__AVX512F__) && defined(__AVX512BW__)
   const size_t WIDTH         = sizeof(__m512i) / sizeof(int16_t);
-  const size_t WEIGHT_CHUNKS = (N_FEATURES * N_HIDDEN) / WIDTH;
-  const size_t BIAS_CHUNKS   = N_HIDDEN / WIDTH;
+  const size_t WEIGHT_CHUNKS = (N_FEATURES * hidden) / WIDTH;
+  const size_t BIAS_CHUNKS   = hidden / WIDTH;
 
-  __m512i* weights = (__m512i*) INPUT_WEIGHTS;
-  __m512i* biases  = (__m512i*) INPUT_BIASES;
+  __m512i* weights = (__m512i*) inputWeights;
+  __m512i* biases  = (__m512i*) net->inputBiases;
 
   for (size_t i = 0; i < WEIGHT_CHUNKS; i += 2) {
     __m128i a1 = _mm512_extracti32x4_epi32(weights[i], 1);
@@ -753,11 +1110,11 @@ INLINE void CopyData(const unsigned char* in) {
   }
 #elif defined(__AVX2__)
   const size_t WIDTH         = sizeof(__m256i) / sizeof(int16_t);
-  const size_t WEIGHT_CHUNKS = (N_FEATURES * N_HIDDEN) / WIDTH;
-  const size_t BIAS_CHUNKS   = N_HIDDEN / WIDTH;
+  const size_t WEIGHT_CHUNKS = (N_FEATURES * hidden) / WIDTH;
+  const size_t BIAS_CHUNKS   = hidden / WIDTH;
 
-  __m256i* weights = (__m256i*) INPUT_WEIGHTS;
-  __m256i* biases  = (__m256i*) INPUT_BIASES;
+  __m256i* weights = (__m256i*) inputWeights;
+  __m256i* biases  = (__m256i*) net->inputBiases;
 
   for (size_t i = 0; i < WEIGHT_CHUNKS; i += 2) {
     __m128i a1 = _mm256_extracti128_si256(weights[i], 1);
@@ -775,6 +1132,11 @@ INLINE void CopyData(const unsigned char* in) {
     biases[i + 1] = _mm256_inserti128_si256(biases[i + 1], a1, 0);
   }
 #endif
+
+#if defined(NN_INT8)
+  QuantizeInputWeights(net, inputWeights, hidden);
+  AlignedFree(inputWeights);
+#endif
 }
 
 INLINE void InitLookupIndices() {
@@ -786,32 +1148,213 @@ INLINE void InitLookupIndices() {
   }
 }
 
+// Anything derived from the previous network is stale after a load. The
+// small network's refresh tables are (re)set with its memory
+static void ResetThreadsNetworkState() {
+  ThreadsSmallNetworkMemory();
+
+  for (int i = 0; i < Threads.count; i++) {
+    ResetRefreshTable(&NETWORK, Threads.threads[i]->refreshTable);
+    memset(Threads.threads[i]->evalCache, 0, sizeof(Threads.threads[i]->evalCache));
+  }
+}
+
 void LoadDefaultNN() {
   InitLookupIndices();
 
-  CopyData(EmbedData);
+  // The embedded network may be headerless, or carry a plain format header
+  const NNFileHeader* header = (const NNFileHeader*) EmbedData;
+  if (memcmp(header->magic, NN_FILE_MAGIC, sizeof(header->magic))) {
+    CopyData(&NETWORK, EmbedData, N_HIDDEN_DEFAULT);
+  } else {
+    const char* reason = header->format != NN_FORMAT_PLAIN ? "is not in the plain format" : IncompatibleHeader(header);
+    if (reason)
+      printf("Embedded network %s.\n", reason), exit(1);
+
+    CopyData(&NETWORK, EmbedData + NN_FILE_HEADER, header->hidden);
+  }
+
+  ResetThreadsNetworkState();
+}
+
+// Copy everything after the input weights out of an exported network
+INLINE void CopyExportedData(Network* net, const unsigned char* in, const size_t hidden) {
+  size_t offset = NN_FILE_HEADER + InputWeightsSize(hidden);
+
+  memcpy(net->inputBiases, &in[offset], hidden * sizeof(int16_t));
+  offset += hidden * sizeof(int16_t);
+  memcpy(net->l1Weights, &in[offset], 2 * hidden * N_L2 * sizeof(int8_t));
+  offset += 2 * hidden * N_L2 * sizeof(int8_t);
+  memcpy(net->l1Biases, &in[offset], N_L2 * sizeof(int32_t));
+  offset += N_L2 * sizeof(int32_t);
+  memcpy(net->l2Weights, &in[offset], N_L2 * N_L3 * sizeof(float));
+  offset += N_L2 * N_L3 * sizeof(float);
+  memcpy(net->l2Biases, &in[offset], N_L3 * sizeof(float));
+  offset += N_L3 * sizeof(float);
+  memcpy(net->outputWeights, &in[offset], N_L3 * N_OUTPUT * sizeof(float));
+  offset += N_L3 * N_OUTPUT * sizeof(float);
+  memcpy(&net->outputBias, &in[offset], sizeof(float));
+#if defined(NN_INT8)
+  offset += sizeof(float);
+  memcpy(net->inputScales, &in[offset], hidden * sizeof(int16_t));
+#endif
+
+  net->hidden = hidden;
 }
 
-int LoadNetwork(char* path) {
+// Map an exported network read-only and shared, so that every process using
+// the same file shares a single page cache copy of the input weights
+static int LoadExportedNetwork(Network* net, char* path, const size_t hidden) {
+  NNFileHeader expected;
+  NNFileHeaderInit(&expected, NN_FORMAT_IMAGE, hidden);
+
+  const size_t size = NN_FILE_HEADER + ExportedSize(hidden);
+
+#if !defined(_WIN32)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  void* mem = MAP_FAILED;
+  if (!fstat(fd, &st) && (uint64_t) st.st_size >= size)
+    mem = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mem == MAP_FAILED)
+    return 0;
+
+  if (memcmp(mem, &expected, sizeof(NNFileHeader))) {
+    munmap(mem, size);
+    return 0;
+  }
+
+#if defined(MADV_WILLNEED)
+  madvise(mem, size, MADV_WILLNEED);
+#endif
+
+  FreeInputWeights(net);
+
+  net->mem          = mem;
+  net->memSize      = size;
+  net->memPages     = PAGES_FILE;
+  net->inputWeights = (weight_t*) ((char*) mem + NN_FILE_HEADER);
+
+  CopyExportedData(net, mem, hidden);
+#else
+  FILE* fin = fopen(path, "rb");
+  if (fin == NULL)
+    return 0;
+
+  uint8_t* data = malloc(size);
+  int valid     = fread(data, sizeof(uint8_t), size, fin) == size && !memcmp(data, &expected, sizeof(NNFileHeader));
+  fclose(fin);
+
+  if (valid) {
+    AllocInputWeights(net, hidden);
+    memcpy(net->inputWeights, data + NN_FILE_HEADER, InputWeightsSize(hidden));
+    CopyExportedData(net, data, hidden);
+  }
+
+  free(data);
+
+  if (!valid)
+    return 0;
+#endif
+
+  return 1;
+}
+
+// Read the header of a network if it has one, without consuming the file
+static int ReadNetworkHeader(FILE* fin, NNFileHeader* header) {
+  int found =
+    fread(header, sizeof(NNFileHeader), 1, fin) == 1 && !memcmp(header->magic, NN_FILE_MAGIC, sizeof(header->magic));
+
+  rewind(fin);
+  return found;
+}
+
+static int ReadPlainNetwork(Network* net, FILE* fin, const long offset, const size_t hidden) {
+  const size_t size = NetworkSize(hidden);
+
+  uint8_t* data = malloc(size);
+  int valid     = !fseek(fin, offset, SEEK_SET) && fread(data, sizeof(uint8_t), size, fin) == size;
+
+  if (valid)
+    CopyData(net, data, hidden);
+
+  free(data);
+  return valid;
+}
+
+int LoadNetwork(Network* net, char* path) {
   FILE* fin = fopen(path, "rb");
   if (fin == NULL) {
     printf("info string Unable to read file at %s\n", path);
     return 0;
   }
 
-  uint8_t* data = malloc(NETWORK_SIZE);
-  if (fread(data, sizeof(uint8_t), NETWORK_SIZE, fin) != NETWORK_SIZE) {
-    printf("info string Error reading file at %s\n", path);
+  NNFileHeader header;
+  int loaded;
+
+  if (!ReadNetworkHeader(fin, &header)) {
+    loaded = ReadPlainNetwork(net, fin, 0, N_HIDDEN_DEFAULT);
+  } else if (IncompatibleHeader(&header)) {
+    printf("info string Network at %s %s\n", path, IncompatibleHeader(&header));
+    fclose(fin);
     return 0;
+  } else if (header.format == NN_FORMAT_IMAGE) {
+    loaded = LoadExportedNetwork(net, path, header.hidden);
+  } else {
+    loaded = ReadPlainNetwork(net, fin, NN_FILE_HEADER, header.hidden);
   }
 
-  CopyData(data);
+  fclose(fin);
 
-  for (int i = 0; i < Threads.count; i++)
-    ResetRefreshTable(Threads.threads[i]->refreshTable);
+  if (!loaded) {
+    printf("info string Error reading file at %s\n", path);
+    return 0;
+  }
 
-  fclose(fin);
-  free(data);
+  // The default network may not have been loaded yet, see FinishStartup
+  InitLookupIndices();
+  ResetThreadsNetworkState();
 
   return 1;
 }
+
+void UnloadNetwork(Network* net) {
+  FreeInputWeights(net);
+  net->hidden = 0;
+
+  ResetThreadsNetworkState();
+}
+
+// Write the current network in the exported format, see LoadExportedNetwork
+int ExportNetwork(char* path) {
+  FILE* fout = fopen(path, "wb");
+  if (fout == NULL)
+    return 0;
+
+  const Network* net  = &NETWORK;
+  const size_t hidden = net->hidden;
+
+  char header[NN_FILE_HEADER] = {0};
+  NNFileHeaderInit((NNFileHeader*) header, NN_FORMAT_IMAGE, hidden);
+
+  int success = fwrite(header, sizeof(header), 1, fout) == 1 &&
+                fwrite(net->inputWeights, sizeof(weight_t), N_FEATURES * hidden, fout) == N_FEATURES * hidden &&
+                fwrite(net->inputBiases, sizeof(int16_t), hidden, fout) == hidden &&
+                fwrite(net->l1Weights, sizeof(int8_t), 2 * hidden * N_L2, fout) == 2 * hidden * N_L2 &&
+                fwrite(net->l1Biases, sizeof(int32_t), N_L2, fout) == N_L2 &&
+                fwrite(net->l2Weights, sizeof(float), N_L2 * N_L3, fout) == N_L2 * N_L3 &&
+                fwrite(net->l2Biases, sizeof(float), N_L3, fout) == N_L3 &&
+                fwrite(net->outputWeights, sizeof(float), N_L3 * N_OUTPUT, fout) == N_L3 * N_OUTPUT &&
+                fwrite(&net->outputBias, sizeof(float), 1, fout) == 1;
+#if defined(NN_INT8)
+  success = success && fwrite(net->inputScales, sizeof(int16_t), hidden, fout) == hidden;
+#endif
+
+  fclose(fout);
+  return success;
+}
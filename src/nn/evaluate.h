@@ -20,11 +20,18 @@
 #include "../types.h"
 
 #define SPARSE_CHUNK_SIZE 4
+#define EVAL_BATCH_SIZE   32
+
+extern Network NETWORK;
+extern Network SMALL_NETWORK; // optional, see Evaluate
 
 int Predict(Board* board);
-int Propagate(Accumulator* accumulator, const int stm);
+void PredictBatch(Board* boards, int n, int* scores);
+int Propagate(const Network* net, Accumulator* accumulator, const int stm);
 
 void LoadDefaultNN();
-int LoadNetwork(char* path);
+int LoadNetwork(Network* net, char* path);
+void UnloadNetwork(Network* net);
+int ExportNetwork(char* path);
 
 #endif
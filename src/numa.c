@@ -0,0 +1,170 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include "numa.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+int NUMA_BIND = 0;
+int NUMA_HASH = NUMA_HASH_FIRST_TOUCH;
+
+#if defined(__linux__)
+
+// Not exposed by glibc without libnuma's <numaif.h>
+#define NUMA_MPOL_INTERLEAVE 3
+#define NUMA_MPOL_MF_MOVE    (1 << 1)
+
+static int nodeCount = 1;
+static int nodeIds[MAX_NUMA_NODES];
+static cpu_set_t nodeCpus[MAX_NUMA_NODES];
+
+// Parse a sysfs list like "0-15,32-47" into a cpu set
+static void ParseCpuList(const char* list, cpu_set_t* set) {
+  CPU_ZERO(set);
+
+  while (*list) {
+    char* end;
+    long from = strtol(list, &end, 10);
+    if (end == list)
+      break;
+
+    long to = from;
+    if (*end == '-')
+      to = strtol(end + 1, &end, 10);
+
+    for (long cpu = from; cpu <= to && cpu < CPU_SETSIZE; cpu++)
+      CPU_SET(cpu, set);
+
+    list = *end == ',' ? end + 1 : end;
+  }
+}
+
+static int ReadCpuList(const char* path, cpu_set_t* set) {
+  char buffer[4096];
+
+  FILE* fp = fopen(path, "r");
+  if (!fp)
+    return 0;
+
+  int success = fgets(buffer, sizeof(buffer), fp) != NULL;
+  fclose(fp);
+
+  if (success)
+    ParseCpuList(buffer, set);
+
+  return success;
+}
+
+// Read the node topology from sysfs, keeping only nodes which have
+// cpus this process is allowed to run on (memory only nodes are skipped)
+void NumaInit() {
+  cpu_set_t allowed, online;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) ||
+      !ReadCpuList("/sys/devices/system/node/online", &online))
+    return;
+
+  nodeCount = 0;
+  for (int node = 0; node < CPU_SETSIZE && nodeCount < MAX_NUMA_NODES; node++) {
+    if (!CPU_ISSET(node, &online))
+      continue;
+
+    char path[64];
+    sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+
+    cpu_set_t* cpus = &nodeCpus[nodeCount];
+    if (!ReadCpuList(path, cpus))
+      continue;
+
+    CPU_AND(cpus, cpus, &allowed);
+    if (CPU_COUNT(cpus))
+      nodeIds[nodeCount++] = node;
+  }
+
+  if (!nodeCount) {
+    nodeCount   = 1;
+    nodeIds[0]  = 0;
+    nodeCpus[0] = allowed;
+  }
+}
+
+int NumaNodes() {
+  return nodeCount;
+}
+
+// Threads are spread round robin so every count is balanced across nodes
+int NumaNodeForThread(int idx) {
+  return idx % nodeCount;
+}
+
+// Pin the calling thread to every cpu of its node, letting the
+// scheduler balance within the node
+void NumaBindThread(int idx) {
+  if (!NUMA_BIND || nodeCount < 2)
+    return;
+
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &nodeCpus[NumaNodeForThread(idx)]);
+}
+
+// Spread the pages of an (untouched) allocation round robin across all nodes.
+// This is a placement hint, so failure silently leaves the default policy.
+void NumaInterleave(void* mem, size_t size) {
+  if (nodeCount < 2)
+    return;
+
+  unsigned long mask[CPU_SETSIZE / (8 * sizeof(unsigned long))] = {0};
+  for (int i = 0; i < nodeCount; i++)
+    mask[nodeIds[i] / (8 * sizeof(unsigned long))] |= 1UL << (nodeIds[i] % (8 * sizeof(unsigned long)));
+
+  syscall(SYS_mbind, mem, size, NUMA_MPOL_INTERLEAVE, mask, 8 * sizeof(mask) + 1, NUMA_MPOL_MF_MOVE);
+}
+
+#else
+
+void NumaInit() {
+}
+
+int NumaNodes() {
+  return 1;
+}
+
+int NumaNodeForThread(int idx) {
+  (void) idx;
+  return 0;
+}
+
+void NumaBindThread(int idx) {
+  (void) idx;
+}
+
+void NumaInterleave(void* mem, size_t size) {
+  (void) mem;
+  (void) size;
+}
+
+#endif
@@ -0,0 +1,38 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stddef.h>
+
+#define MAX_NUMA_NODES 64
+
+enum {
+  NUMA_HASH_FIRST_TOUCH,
+  NUMA_HASH_INTERLEAVE
+};
+
+extern int NUMA_BIND;
+extern int NUMA_HASH;
+
+void NumaInit();
+int NumaNodes();
+int NumaNodeForThread(int idx);
+void NumaBindThread(int idx);
+void NumaInterleave(void* mem, size_t size);
+
+#endif
@@ -14,16 +14,48 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include "perft.h"
+
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
 #include "move.h"
 #include "movegen.h"
 #include "movepick.h"
+#include "thread.h"
 #include "types.h"
 #include "util.h"
 
+int PERFT_HASH_MB = 0;
+
+// Lockless entries, the key is stored xor'd with the count so a torn entry
+// never verifies. The depth lives in the low byte of the key
+typedef struct {
+  _Atomic uint64_t key;
+  _Atomic uint64_t nodes;
+} PerftEntry;
+
+static PerftEntry* PERFT_HASH = NULL;
+static uint64_t PERFT_HASH_MASK;
+
+// Root moves are handed out one at a time to whichever thread is free
+static struct {
+  Board* board;
+  int depth, count;
+  atomic_int next;
+  Move moves[MAX_MOVES];
+  uint64_t nodes[MAX_MOVES];
+  long time[256];
+} PERFT;
+
+INLINE uint64_t PerftKey(Board* board, int depth) {
+  return (board->zobrist & ~0xFFULL) | depth;
+}
+
 uint64_t Perft(int depth, Board* board) {
   if (depth == 0)
     return 1;
@@ -35,6 +67,17 @@ uint64_t Perft(int depth, Board* board) {
   if (depth == 1)
     return mp.end - mp.moves;
 
+  PerftEntry* entry = NULL;
+  const uint64_t key = PerftKey(board, depth);
+
+  if (PERFT_HASH) {
+    entry = &PERFT_HASH[board->zobrist & PERFT_HASH_MASK];
+
+    const uint64_t nodes = LoadRlx(entry->nodes);
+    if ((LoadRlx(entry->key) ^ nodes) == key)
+      return nodes;
+  }
+
   uint64_t nodes = 0;
   while ((move = NextMove(&mp, board, 0))) {
     MakeMoveUpdate(move, board, 0);
@@ -42,32 +85,88 @@ uint64_t Perft(int depth, Board* board) {
     UndoMove(move, board);
   }
 
+  if (entry) {
+    atomic_store_explicit(&entry->key, key ^ nodes, memory_order_relaxed);
+    atomic_store_explicit(&entry->nodes, nodes, memory_order_relaxed);
+  }
+
   return nodes;
 }
 
+void PerftThread(ThreadData* thread) {
+  Board* board = &thread->board;
+  memcpy(board, PERFT.board, offsetof(Board, accumulators));
+
+  uint64_t nodes = 0;
+  long startTime = GetTimeMS();
+
+  int i;
+  while ((i = atomic_fetch_add(&PERFT.next, 1)) < PERFT.count) {
+    MakeMoveUpdate(PERFT.moves[i], board, 0);
+    PERFT.nodes[i] = Perft(PERFT.depth - 1, board);
+    UndoMove(PERFT.moves[i], board);
+
+    nodes += PERFT.nodes[i];
+  }
+
+  thread->nodes           = nodes;
+  PERFT.time[thread->idx] = GetTimeMS() - startTime;
+}
+
 void PerftTest(int depth, Board* board) {
   uint64_t total = 0;
 
   printf("\nRunning performance test to depth %d\n\n", depth);
 
+  if (PERFT_HASH_MB) {
+    uint64_t entries = 1;
+    while (2 * entries * sizeof(PerftEntry) <= (uint64_t) PERFT_HASH_MB * 1024 * 1024)
+      entries *= 2;
+
+    PERFT_HASH      = calloc(entries, sizeof(PerftEntry));
+    PERFT_HASH_MASK = entries - 1;
+  }
+
   long startTime = GetTimeMS();
 
   Move move;
   MovePicker mp;
   InitPerftMovePicker(&mp, board);
 
-  while ((move = NextMove(&mp, board, 0))) {
-    MakeMoveUpdate(move, board, 0);
-    uint64_t nodes = Perft(depth - 1, board);
-    UndoMove(move, board);
+  PERFT.board = board;
+  PERFT.depth = Max(1, depth);
+  PERFT.count = 0;
+  atomic_store(&PERFT.next, 0);
+  while ((move = NextMove(&mp, board, 0)))
+    PERFT.moves[PERFT.count++] = move;
 
-    printf("%5s: %" PRIu64 "\n", MoveToStr(move, board), nodes);
-    total += nodes;
+  ThreadsRun(THREAD_PERFT);
+  ThreadsWait();
+
+  for (int i = 0; i < PERFT.count; i++) {
+    printf("%5s: %" PRIu64 "\n", MoveToStr(PERFT.moves[i], board), PERFT.nodes[i]);
+    total += PERFT.nodes[i];
   }
 
   long endTime = GetTimeMS();
 
+  if (Threads.count > 1) {
+    printf("\n");
+    for (int i = 0; i < Threads.count; i++) {
+      const uint64_t nodes = LoadRlx(Threads.threads[i]->nodes);
+      const long time      = PERFT.time[Threads.threads[i]->idx];
+
+      printf("Thread %3d: %14" PRIu64 " nodes %12" PRIu64 " nps\n",
+             Threads.threads[i]->idx,
+             nodes,
+             nodes / Max(1, time) * 1000);
+    }
+  }
+
   printf("\nNodes: %" PRIu64 "\n", total);
   printf("Time: %ldms\n", (endTime - startTime));
   printf("NPS: %" PRIu64 "\n\n", total / Max(1, (endTime - startTime)) * 1000);
-}
\ No newline at end of file
+
+  free(PERFT_HASH);
+  PERFT_HASH = NULL;
+}
@@ -19,7 +19,10 @@
 
 #include "types.h"
 
-int Perft(int depth, Board* board);
+extern int PERFT_HASH_MB;
+
+uint64_t Perft(int depth, Board* board);
+void PerftThread(ThreadData* thread);
 void PerftTest(int depth, Board* board);
 
 #endif
\ No newline at end of file
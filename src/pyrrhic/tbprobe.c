@@ -321,6 +321,7 @@ struct BaseEntry {
     uint8_t pawns[2];
   };
   bool dtmLossOnly;
+  char name[16];
 };
 
 struct PieceEntry {
@@ -566,6 +567,7 @@ static void init_tb(char *str) {
   be->key              = key;
   be->symmetric        = key == key2;
   be->num              = 0;
+  strcpy(be->name, str);
   for (int i = 0; i < 16; i++)
     be->num += pcs[i];
 
@@ -1185,6 +1187,59 @@ static struct PairsData *setup_pairs(uint8_t **ptr, size_t tb_size, size_t *size
   return d;
 }
 
+static bool init_table(struct BaseEntry *be, const char *str, int type);
+
+static size_t prefault_table(const uint8_t *data, map_t mapping, bool lock) {
+#ifndef _WIN32
+#if defined(MADV_WILLNEED)
+  madvise((void *) data, mapping, MADV_WILLNEED);
+#endif
+  volatile uint8_t sink = 0;
+  for (size_t i = 0; i < mapping; i += 4096)
+    sink ^= data[i];
+
+  if (lock && mlock(data, mapping))
+    perror("mlock");
+
+  return mapping;
+#else
+  (void) data;
+  (void) mapping;
+  (void) lock;
+  return 0;
+#endif
+}
+
+static size_t preload_entry(struct BaseEntry *be, int pieces, bool lock) {
+  if (be->num > pieces)
+    return 0;
+
+  if (!atomic_load_explicit(&be->ready[WDL], memory_order_acquire)) {
+    LOCK(tbMutex);
+    if (!atomic_load_explicit(&be->ready[WDL], memory_order_relaxed)) {
+      if (!init_table(be, be->name, WDL)) {
+        UNLOCK(tbMutex);
+        return 0;
+      }
+      atomic_store_explicit(&be->ready[WDL], true, memory_order_release);
+    }
+    UNLOCK(tbMutex);
+  }
+
+  return prefault_table(be->data[WDL], be->mapping[WDL], lock);
+}
+
+size_t tb_preload(int pieces, bool lock) {
+  size_t bytes = 0;
+
+  for (int i = 0; i < tbNumPiece; i++)
+    bytes += preload_entry(&pieceEntry[i].be, pieces, lock);
+  for (int i = 0; i < tbNumPawn; i++)
+    bytes += preload_entry(&pawnEntry[i].be, pieces, lock);
+
+  return bytes;
+}
+
 static bool init_table(struct BaseEntry *be, const char *str, int type) {
   uint8_t *data = (uint8_t *) map_tb(str, tbSuffix[type], &be->mapping[type]);
   if (!data)
@@ -102,6 +102,21 @@ bool tb_init(const char *_path);
  */
 void tb_free(void);
 
+/*
+ * Map the WDL tables with at most `pieces' men now rather than on their first
+ * probe, touching every page so that it is read in from disk.
+ *
+ * PARAMETERS:
+ * - pieces:
+ *   The largest tables to load.
+ * - lock:
+ *   Also mlock() the loaded tables so they are never paged out.
+ *
+ * RETURN:
+ * - The number of bytes loaded.
+ */
+size_t tb_preload(int pieces, bool lock);
+
 /*
  * Probe the Win-Draw-Loss (WDL) table.
  *
@@ -31,10 +31,13 @@
 #include "movegen.h"
 #include "movepick.h"
 #include "nn/accumulator.h"
+#include "nn/evaluate.h"
 #include "pyrrhic/tbprobe.h"
 #include "see.h"
+#include "stats.h"
 #include "tb.h"
 #include "thread.h"
+#include "trace.h"
 #include "transposition.h"
 #include "types.h"
 #include "uci.h"
@@ -46,6 +49,40 @@ int LMR[MAX_SEARCH_PLY][64];
 int LMP[2][MAX_SEARCH_PLY];
 int STATIC_PRUNE[2][MAX_SEARCH_PLY];
 
+int HELPER_POLICY = HELPER_POLICY_NONE;
+int ABDADA        = 0;
+int WARM_START    = 0;
+int SEED_HELPERS  = 0;
+int MULTIPV_SPLIT = 0;
+
+// The last search's pv, for a root further down it to pick up from
+typedef struct {
+  int count, depth, score;
+  Move moves[MAX_SEARCH_PLY];
+  uint64_t keys[MAX_SEARCH_PLY]; // zobrist after playing moves[0..i]
+} WarmStart;
+
+WarmStart WARM;
+
+// ABDADA style table of the children some thread is busy with. Slots are
+// claimed by the first thread to want them, collisions just go unmarked.
+#define SEARCHING_SIZE 4096
+#define ABDADA_DEPTH   5
+
+typedef struct {
+  atomic_uint_fast64_t key;
+  atomic_int owner; // thread index + 1, 0 when free
+  atomic_int depth;
+} SearchingEntry;
+
+SearchingEntry SEARCHING[SEARCHING_SIZE];
+
+// Helper i skips SKIP_SIZE[i] iterations after every SKIP_SIZE[i] it searches,
+// with SKIP_PHASE[i] shifting the pattern so helpers of one size cover each other
+#define SKIP_PATTERNS 20
+const int SKIP_SIZE[SKIP_PATTERNS]  = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+const int SKIP_PHASE[SKIP_PATTERNS] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
 void InitPruningAndReductionTables() {
   for (int depth = 1; depth < MAX_SEARCH_PLY; depth++)
     for (int moves = 1; moves < 64; moves++)
@@ -65,6 +102,12 @@ void InitPruningAndReductionTables() {
   }
 }
 
+// What the time limits are measured against, the nodes of all threads with
+// nodestime so that play doesn't depend on the speed of the machine
+INLINE int64_t Elapsed() {
+  return Limits.nodesTime ? (int64_t) NodesSearched() : GetTimeMS() - Limits.start;
+}
+
 INLINE int CheckLimits(ThreadData* thread) {
   if (--thread->calls > 0)
     return 0;
@@ -73,11 +116,93 @@ INLINE int CheckLimits(ThreadData* thread) {
   if (Threads.ponder)
     return 0;
 
-  long elapsed = GetTimeMS() - Limits.start;
-  return (Limits.timeset && elapsed >= Limits.max) || //
+  return (Limits.timeset && Elapsed() >= Limits.max) || //
          (Limits.nodes && NodesSearched() >= Limits.nodes);
 }
 
+// Start the loads a child begins with before the move is made: its TT bucket,
+// its eval cache entry and the weights rows of its accumulator update
+INLINE void PrefetchChild(ThreadData* thread, Board* board, const Move move) {
+  const uint64_t key = KeyAfter(board, move);
+
+  TTPrefetch(key);
+#if !defined(NO_PREFETCH)
+  __builtin_prefetch(&thread->evalCache[key & EVAL_CACHE_MASK]);
+  PrefetchMoveFeatures(&NETWORK, board, move);
+#else
+  (void) thread;
+#endif
+}
+
+// Cooperative stop, once set every node returns right after undoing its move
+// so the board, the accumulators and the search state are left untouched
+INLINE int SearchStopped(ThreadData* thread) {
+  if (!thread->stopped && (LoadRlx(Threads.stop) || (!thread->idx && CheckLimits(thread)) ||
+                           (thread->nodeLimit && LoadRlx(thread->nodes) >= thread->nodeLimit)))
+    thread->stopped = 1;
+
+  return thread->stopped;
+}
+
+const char* HelperPolicyName() {
+  return HELPER_POLICY == HELPER_POLICY_SKIP ? "skip" : HELPER_POLICY == HELPER_POLICY_WINDOW ? "window" : "none";
+}
+
+// A split helper's line k is the best move outside the main thread's first k
+// lines, so those are moved to the front of its own root moves first
+static void PullSplitLines(ThreadData* thread, int k) {
+  for (int i = 0; i < k; i++) {
+    const Move move = atomic_load_explicit(&Threads.splitMoves[i], memory_order_relaxed);
+
+    for (int j = i; j < thread->numRootMoves; j++) {
+      if (thread->rootMoves[j].move != move)
+        continue;
+
+      RootMove temp        = thread->rootMoves[j];
+      thread->rootMoves[j] = thread->rootMoves[i];
+      thread->rootMoves[i] = temp;
+      break;
+    }
+  }
+
+  SortRootMoves(thread, k);
+}
+
+INLINE int HelperSkipsDepth(ThreadData* thread) {
+  if (HELPER_POLICY != HELPER_POLICY_SKIP || !thread->idx)
+    return 0;
+
+  const int i = (thread->idx - 1) % SKIP_PATTERNS;
+  return ((thread->depth + thread->board.moveNo + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2;
+}
+
+// Is another thread searching this child from a node at least as deep
+INLINE int SearchedElsewhere(ThreadData* thread, uint64_t key, int depth) {
+  SearchingEntry* entry = &SEARCHING[key & (SEARCHING_SIZE - 1)];
+  const int owner       = LoadRlx(entry->owner);
+
+  return owner && owner != thread->idx + 1 && LoadRlx(entry->key) == key && LoadRlx(entry->depth) >= depth;
+}
+
+// Returns the claimed slot to release after the search, or NULL
+INLINE SearchingEntry* MarkSearching(ThreadData* thread, uint64_t key, int depth) {
+  SearchingEntry* entry = &SEARCHING[key & (SEARCHING_SIZE - 1)];
+  int free              = 0;
+
+  if (!atomic_compare_exchange_strong_explicit(
+        &entry->owner, &free, thread->idx + 1, memory_order_relaxed, memory_order_relaxed))
+    return NULL;
+
+  atomic_store_explicit(&entry->key, key, memory_order_relaxed);
+  atomic_store_explicit(&entry->depth, depth, memory_order_relaxed);
+  return entry;
+}
+
+INLINE void ReleaseSearching(SearchingEntry* entry) {
+  if (entry)
+    atomic_store_explicit(&entry->owner, 0, memory_order_relaxed);
+}
+
 INLINE int AdjustEvalOnFMR(Board* board, int eval) {
   return (200 - board->fmr) * eval / 200;
 }
@@ -86,18 +211,93 @@ INLINE int ThreadValue(ThreadData* thread, const int worstScore) {
   return (thread->rootMoves[0].score - worstScore) * thread->depth;
 }
 
+// Remember the best pv and how deep it was searched, see WarmStartRoot
+static void SaveWarmStart(ThreadData* thread) {
+  RootMove* rm = &thread->rootMoves[0];
+
+  Board board;
+  memcpy(&board, &thread->board, offsetof(Board, accumulators));
+
+  WARM.count = rm->pv.count;
+  WARM.depth = thread->completedDepth;
+  WARM.score = rm->score;
+  for (int i = 0; i < WARM.count; i++) {
+    WARM.moves[i] = rm->pv.moves[i];
+    MakeMoveUpdate(WARM.moves[i], &board, 0);
+    WARM.keys[i] = board.zobrist;
+  }
+}
+
+// When the new root lies on the last pv, move its continuation to the front
+// with the known score and pv, skipping the iterations already covered
+static void WarmStartRoot(Board* board) {
+  if (!WARM_START || Limits.multiPV > 1 || Limits.searchMoves)
+    return;
+
+  ThreadData* mainThread = Threads.threads[0];
+  for (int k = 0; k < WARM.count - 1; k++) {
+    if (WARM.keys[k] != board->zobrist)
+      continue;
+
+    for (int i = 0; i < mainThread->numRootMoves; i++) {
+      if (mainThread->rootMoves[i].move != WARM.moves[k + 1])
+        continue;
+
+      RootMove rm = mainThread->rootMoves[i];
+      memmove(&mainThread->rootMoves[1], &mainThread->rootMoves[0], i * sizeof(RootMove));
+
+      // k + 1 plies were played since, the score flips with the side to move
+      rm.score = rm.previousScore = rm.avgScore = k & 1 ? WARM.score : -WARM.score;
+      rm.pv.count = WARM.count - k - 1;
+      memcpy(rm.pv.moves, &WARM.moves[k + 1], rm.pv.count * sizeof(Move));
+
+      mainThread->rootMoves[0] = rm;
+      mainThread->startDepth   = Max(0, WARM.depth - k - 2);
+      return;
+    }
+  }
+}
+
+// Limits of a search without a clock, as ParseGo sets them up before its time
+// management: 0 for no depth, nodes or movetime (ms) limit. quiet and report
+// are up to the caller
+void SetSearchLimits(int depth, uint64_t nodes, int movetime, int multiPV) {
+  Limits.start            = GetTimeMS();
+  Limits.depth            = depth > 0 ? Min(MAX_SEARCH_PLY - 1, depth) : MAX_SEARCH_PLY - 1;
+  Limits.nodes            = nodes;
+  Limits.hitrate          = nodes ? Min(1000, Max(1, nodes / 100)) : 1000;
+  Limits.timeset          = movetime > 0;
+  Limits.alloc            = movetime > 0 ? INT64_MAX : 0;
+  Limits.max              = movetime > 0 ? movetime : INT_MAX;
+  Limits.nodesTime        = 0;
+  Limits.multiPV          = Max(1, multiPV);
+  Limits.mate             = 0;
+  Limits.infinite         = 0;
+  Limits.stopped          = 0;
+  Limits.quit             = 0;
+  Limits.searchMoves      = 0;
+  Limits.searchable.count = 0;
+  Limits.independent      = 0;
+}
+
 void StartSearch(Board* board, uint8_t ponder) {
   if (Threads.searching)
     ThreadWaitUntilSleep(Threads.threads[0]);
 
+  TBWaitForInit();
+
+  Threads.startTime       = GetTimeUS();
   Threads.stopOnPonderHit = 0;
   Threads.stop            = 0;
   Threads.ponder          = ponder;
+  atomic_store(&Threads.lastWake, 0);
 
   // Setup Threads
   SetupMainThread(board);
+  WarmStartRoot(board);
   SetupOtherThreads(board);
 
+  Threads.setupTime += GetTimeUS() - Threads.startTime;
   Threads.searching = 1;
   ThreadWake(Threads.threads[0], THREAD_SEARCH);
 }
@@ -106,29 +306,47 @@ void MainSearch() {
   ThreadData* mainThread = Threads.threads[0];
   Board* board           = &mainThread->board;
 
-  char startFen[128];
-  BoardToFen(startFen, board);
-
   TTUpdate();
 
-  for (int i = 1; i < Threads.count; i++)
-    ThreadWake(Threads.threads[i], THREAD_SEARCH);
+  ThreadsWakeHelpers(THREAD_SEARCH);
   Search(mainThread);
 
   pthread_mutex_lock(&Threads.lock);
   if (!Threads.stop && (Threads.ponder || Limits.infinite)) {
     Threads.sleeping = 1;
     pthread_mutex_unlock(&Threads.lock);
+    TraceBegin(mainThread, "ponder wait", 0);
     ThreadWait(mainThread, &Threads.stop);
+    TraceEnd(mainThread, "ponder wait");
   } else {
     pthread_mutex_unlock(&Threads.lock);
   }
 
   Threads.stop = 1;
 
+  uint64_t joinStart = GetTimeUS();
+  TraceBegin(mainThread, "join", Threads.count - 1);
   for (int i = 1; i < Threads.count; i++)
     ThreadWaitUntilSleep(Threads.threads[i]);
 
+  // a search that finished before the root probe still has to play a move
+  // that keeps the tablebase result
+  if (!Limits.searchMoves) {
+    TBRootProbeWait();
+    for (int i = 0; i < Threads.count; i++)
+      TBFilterRootMoves(Threads.threads[i]);
+  }
+
+  // The node clock of nodestime pays for this move and gets the increment
+  if (Limits.nodesTime && Limits.timeset && Limits.nodesLeft)
+    Limits.nodesLeft = Max(1, Limits.nodesLeft + Limits.inc - (int64_t) NodesSearched());
+
+  uint64_t voteStart = GetTimeUS();
+  Threads.joinTime += voteStart - joinStart;
+  Threads.allAwakeTime += LoadRlx(Threads.lastWake);
+  TraceEnd(mainThread, "join");
+  TraceBegin(mainThread, "vote", Threads.count);
+
   int voteMap[64 * 64];
   int worstScore = UNKNOWN;
 
@@ -147,7 +365,10 @@ void MainSearch() {
   Score bestScore        = bestThread->rootMoves[0].score;
   Score bestVoteScore    = voteMap[FromTo(bestThread->rootMoves[0].move)];
 
-  for (int i = 1; i < Threads.count; i++) {
+  // Split helpers don't have every line to report
+  const int voters = MULTIPV_SPLIT && Limits.multiPV > 1 ? 1 : Threads.count;
+
+  for (int i = 1; i < voters; i++) {
     ThreadData* curr    = Threads.threads[i];
     Score currScore     = curr->rootMoves[0].score;
     Score currVoteScore = voteMap[FromTo(curr->rootMoves[0].move)];
@@ -182,7 +403,11 @@ void MainSearch() {
     Threads.threads[0] = bestThread;
   }
 
+  Threads.voteTime += GetTimeUS() - voteStart;
+  TraceEnd(mainThread, "vote");
+
   bestThread->previousScore = bestThread->rootMoves[0].score;
+  SaveWarmStart(bestThread);
 
   Move bestMove   = bestThread->rootMoves[0].move;
   Move ponderMove = NULL_MOVE;
@@ -190,9 +415,6 @@ void MainSearch() {
     ponderMove = bestThread->rootMoves[0].pv.moves[1];
   else {
     // Pull ponder move from the TT if PV doesn't have one.
-    // We reload the startfen because jmp aborts don't guarantee a rolled back board
-    ParseFen(startFen, board);
-
     MakeMove(bestMove, board);
     int ttHit = 0, ttScore, ttEval, ttDepth, ttBound, ttPv = 0;
     TTProbe(board->zobrist, 0, &ttHit, &ponderMove, &ttScore, &ttEval, &ttDepth, &ttBound, &ttPv);
@@ -204,6 +426,14 @@ void MainSearch() {
     UndoMove(bestMove, board);
   }
 
+  if (Limits.report) {
+    Limits.report(bestThread, board, -CHECKMATE, CHECKMATE, bestMove, ponderMove);
+    return;
+  }
+
+  if (Limits.quiet)
+    return;
+
   printf("bestmove %s", MoveToStr(bestMove, board));
   if (ponderMove)
     printf(" ponder %s", MoveToStr(ponderMove, board));
@@ -213,18 +443,41 @@ void MainSearch() {
 void Search(ThreadData* thread) {
   Board* board   = &thread->board;
   int mainThread = !thread->idx;
+  int helper     = !mainThread && !Limits.independent;
+
+  if (helper) {
+    uint64_t woke = GetTimeUS() - Threads.startTime;
+    uint64_t last = LoadRlx(Threads.lastWake);
+
+    atomic_fetch_add_explicit(&Threads.wakeTime, woke, memory_order_relaxed);
+    while (woke > last && !atomic_compare_exchange_weak(&Threads.lastWake, &last, woke))
+      ;
+  }
+
+  thread->depth          = thread->startDepth;
+  thread->completedDepth = thread->startDepth;
+  thread->stopped        = 0;
+
+  // The root only differs from the last search by a few moves, so refresh
+  // the accumulators from the warm refresh table instead of from scratch
+  for (int c = WHITE; c <= BLACK; c++) {
+    RefreshAccumulator(&NETWORK, board->accumulators, board->refreshTable, board, c);
+    if (SMALL_NETWORK.hidden)
+      RefreshAccumulator(&SMALL_NETWORK, board->smallAccumulators, board->smallRefreshTable, board, c);
+  }
 
-  thread->depth       = 0;
-  board->accumulators = thread->accumulators; // exit jumps can cause this pointer to not be reset
-  ResetAccumulator(board->accumulators, board, WHITE);
-  ResetAccumulator(board->accumulators, board, BLACK);
   SetContempt(thread->contempt, board->stm);
 
   PV nullPv;
   int scores[MAX_SEARCH_PLY];
   int searchStability   = 0;
+  int rootFiltered      = 0;
   Move previousBestMove = NULL_MOVE;
 
+  // skipped iterations count as having found the warm start score
+  for (int i = 0; i <= thread->startDepth; i++)
+    scores[i] = thread->rootMoves[0].score;
+
   const int searchOffset = 6;
   SearchStack searchStack[MAX_SEARCH_PLY + searchOffset];
   SearchStack* ss = searchStack + searchOffset;
@@ -235,21 +488,35 @@ void Search(ThreadData* thread) {
     (ss - i)->ch = &thread->ch[0][WHITE_PAWN][A1];
 
   while (++thread->depth < MAX_SEARCH_PLY) {
-#if defined(_WIN32) || defined(_WIN64)
-    if (_setjmp(thread->exit, NULL)) {
-#else
-    if (setjmp(thread->exit)) {
-#endif
-      break;
-    }
-
     if (Limits.depth && mainThread && thread->depth > Limits.depth)
       break;
 
+    if (helper && HelperSkipsDepth(thread))
+      continue;
+
+    TraceBegin(thread, "depth", thread->depth);
+
+    // narrow the root as soon as the DTZ probe is in
+    if (!rootFiltered && !Limits.searchMoves && !Limits.independent && TBRootProbeReady()) {
+      TBFilterRootMoves(thread);
+      rootFiltered = 1;
+    }
+
     for (int i = 0; i < thread->numRootMoves; i++)
       thread->rootMoves[i].previousScore = thread->rootMoves[i].score;
 
-    for (thread->multiPV = 0; thread->multiPV < Limits.multiPV; thread->multiPV++) {
+    // With MultiPVSplit the main thread searches every line and a helper only
+    // one of them, so the helpers fill the hash for each line in turn rather
+    // than all repeating the full set
+    const int multiPV = Min(Limits.multiPV, thread->numRootMoves);
+    const int split   = MULTIPV_SPLIT && helper && multiPV > 1;
+    const int firstPV = split ? (thread->idx - 1) % multiPV : 0;
+    const int lastPV  = split ? firstPV + 1 : multiPV;
+
+    if (split)
+      PullSplitLines(thread, firstPV);
+
+    for (thread->multiPV = firstPV; thread->multiPV < lastPV; thread->multiPV++) {
       int alpha       = -CHECKMATE;
       int beta        = CHECKMATE;
       int delta       = CHECKMATE;
@@ -261,6 +528,8 @@ void Search(ThreadData* thread) {
       // One at depth 5 or later, start search at a reduced window
       if (thread->depth >= 5) {
         delta = 9;
+        if (HELPER_POLICY == HELPER_POLICY_WINDOW && helper)
+          delta += 3 * (thread->idx % 8);
         alpha = Max(score - delta, -CHECKMATE);
         beta  = Min(score + delta, CHECKMATE);
       }
@@ -274,7 +543,11 @@ void Search(ThreadData* thread) {
           beta = CHECKMATE;
 
         // search!
+        TraceBegin(thread, "aspiration", beta - alpha);
         score = Negamax(alpha, beta, Max(1, searchDepth), 0, thread, &nullPv, ss);
+        TraceEnd(thread, "aspiration");
+        if (thread->stopped)
+          break;
 
         SortRootMoves(thread, thread->multiPV);
 
@@ -302,16 +575,31 @@ void Search(ThreadData* thread) {
         delta += 17 * delta / 64;
       }
 
+      if (thread->stopped)
+        break;
+
       SortRootMoves(thread, 0);
 
       // Print if final multipv or time elapsed
-      if (mainThread && (thread->multiPV + 1 == Limits.multiPV || GetTimeMS() - Limits.start >= 2500))
+      if (mainThread && (thread->multiPV + 1 == multiPV || GetTimeMS() - Limits.start >= 2500))
         PrintUCI(thread, -CHECKMATE, CHECKMATE, board);
     }
 
+    TraceEnd(thread, "depth");
+
+    // an interrupted iteration is thrown away
+    if (thread->stopped)
+      break;
+
+    thread->completedDepth = thread->depth;
+
     if (!mainThread)
       continue;
 
+    if (MULTIPV_SPLIT)
+      for (int i = 0; i < multiPV; i++)
+        atomic_store_explicit(&Threads.splitMoves[i], thread->rootMoves[i].move, memory_order_relaxed);
+
     Move bestMove = thread->rootMoves[0].move;
     int bestScore = thread->rootMoves[0].score;
 
@@ -320,7 +608,7 @@ void Search(ThreadData* thread) {
       break;
 
     // Time Management stuff
-    long elapsed = GetTimeMS() - Limits.start;
+    int64_t elapsed = Elapsed();
 
     // Soft TM checks
     if (Limits.timeset && thread->depth >= 5 && !Threads.stopOnPonderHit) {
@@ -380,21 +668,26 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
   Move hashMove = NULL_MOVE;
   Move move     = NULL_MOVE;
 
-  if (!isRoot && board->fmr >= 3 && alpha < 0 && HasCycle(board, ss->ply)) {
-    alpha = 2 - (thread->nodes & 0x3);
-    if (alpha >= beta)
-      return alpha;
+  if (!isRoot && board->fmr >= 3 && alpha < 0) {
+    StatsInc(thread, cycleChecks);
+
+    if (HasCycle(board, ss->ply)) {
+      StatsInc(thread, cycleHits);
+
+      alpha = 2 - (thread->nodes & 0x3);
+      if (alpha >= beta)
+        return alpha;
+    }
   }
 
   // drop into noisy moves only
   if (depth <= 0)
     return Quiesce(alpha, beta, 0, thread, ss);
 
-  if (LoadRlx(Threads.stop) || (!thread->idx && CheckLimits(thread)))
-    // hot exit
-    longjmp(thread->exit, 1);
+  if (SearchStopped(thread))
+    return 0;
 
-  IncRlx(thread->nodes);
+  IncOwned(thread->nodes);
   if (isPV && thread->seldepth < ss->ply + 1)
     thread->seldepth = ss->ply + 1;
 
@@ -425,20 +718,27 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
 
   TTEntry* tt =
     ss->skip ? NULL : TTProbe(board->zobrist, ss->ply, &ttHit, &hashMove, &ttScore, &ttEval, &ttDepth, &ttBound, &ttPv);
+  if (!ss->skip) {
+    StatsInc(thread, ttProbes);
+    if (ttHit)
+      StatsInc(thread, ttHits);
+  }
   hashMove = isRoot ? thread->rootMoves[thread->multiPV].move : hashMove;
 
   // if the TT has a value that fits our position and has been searched to an
   // equal or greater depth, then we accept this score and prune
   if (!isPV && ttScore != UNKNOWN && ttDepth >= depth && (cutnode || ttScore <= alpha) &&
-      (ttBound & (ttScore >= beta ? BOUND_LOWER : BOUND_UPPER)))
+      (ttBound & (ttScore >= beta ? BOUND_LOWER : BOUND_UPPER))) {
+    StatsInc(thread, ttCutoffs);
     return ttScore;
+  }
 
   // tablebase - we do not do this at root
-  if (!isRoot && !ss->skip) {
-    unsigned tbResult = TBProbe(board);
+  if (!isRoot && !ss->skip && depth >= TB_PROBE_DEPTH) {
+    unsigned tbResult = TBProbe(board, thread);
 
     if (tbResult != TB_RESULT_FAILED) {
-      IncRlx(thread->tbhits);
+      IncOwned(thread->tbhits);
 
       score     = tbResult == TB_WIN ? TB_WIN_SCORE - ss->ply : tbResult == TB_LOSS ? -TB_WIN_SCORE + ss->ply : 0;
       int bound = tbResult == TB_WIN ? BOUND_LOWER : tbResult == TB_LOSS ? BOUND_UPPER : BOUND_EXACT;
@@ -522,6 +822,8 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
     // Razoring
     if (depth <= 5 && eval + 214 * depth <= alpha) {
       score = Quiesce(alpha, beta, 0, thread, ss);
+      if (thread->stopped)
+        return 0;
       if (score <= alpha)
         return score;
     }
@@ -534,6 +836,7 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
         HasNonPawn(board, board->stm) && (ss->ply >= thread->nmpMinPly || board->stm != thread->npmColor)) {
       int R = 4 + 385 * depth / 1024 + Min(10 * (eval - beta) / 1024, 4);
 
+      StatsInc(thread, nmpTries);
       TTPrefetch(KeyAfter(board, NULL_MOVE));
       ss->move = NULL_MOVE;
       ss->ch   = &thread->ch[0][WHITE_PAWN][A1];
@@ -543,13 +846,19 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
 
       UndoNullMove(board);
 
+      if (thread->stopped)
+        return 0;
+
       if (score >= beta) {
         if (score >= TB_WIN_BOUND)
           score = beta;
 
-        if (thread->nmpMinPly || (abs(beta) < TB_WIN_BOUND && depth < 14))
+        if (thread->nmpMinPly || (abs(beta) < TB_WIN_BOUND && depth < 14)) {
+          StatsInc(thread, nmpCutoffs);
           return score;
+        }
 
+        StatsInc(thread, nmpVerifies);
         thread->nmpMinPly = ss->ply + 3 * (depth - R) / 4;
         thread->npmColor  = board->stm;
 
@@ -557,8 +866,13 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
 
         thread->nmpMinPly = 0;
 
-        if (verify >= beta)
+        if (thread->stopped)
+          return 0;
+
+        if (verify >= beta) {
+          StatsInc(thread, nmpCutoffs);
           return score;
+        }
       }
     }
 
@@ -572,9 +886,10 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
         if (!IsLegal(move, board))
           continue;
 
-        TTPrefetch(KeyAfter(board, move));
+        StatsInc(thread, pcTries);
+        PrefetchChild(thread, board, move);
         ss->move = move;
-        ss->ch   = &thread->ch[IsCap(move)][Moving(move)][To(move)];
+        ss->ch   = &thread->ch[IsCap(move)][CHRow(Moving(move))][To(move)];
         MakeMove(move, board);
 
         // qsearch to quickly check
@@ -586,8 +901,13 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
 
         UndoMove(move, board);
 
-        if (score >= probBeta)
+        if (thread->stopped)
+          return 0;
+
+        if (score >= probBeta) {
+          StatsInc(thread, pcCutoffs);
           return score;
+        }
       }
     }
   }
@@ -595,24 +915,43 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
   int numQuiets = 0, numCaptures = 0;
   Move quiets[64], captures[32];
 
+  // Moves another thread is already searching go to the back of the line
+  const int abdada = ABDADA && !isRoot && depth >= ABDADA_DEPTH && Threads.count > 1 && !Limits.independent;
+  int numDeferred = 0, deferredIdx = 0;
+  Move deferred[32];
+
   int legalMoves = 0, playedMoves = 0, skipQuiets = 0;
-  InitNormalMovePicker(&mp, hashMove, thread, ss);
+  InitNormalMovePicker(&mp, hashMove, thread, ss, depth);
 
-  while ((move = NextMove(&mp, board, skipQuiets))) {
+  HistoryTables tables;
+  InitHistoryTables(&tables, ss, thread, board);
+
+  while ((move = NextMove(&mp, board, skipQuiets)) ||
+         (deferredIdx < numDeferred && (move = deferred[deferredIdx++]))) {
     if (ss->skip == move)
       continue;
     if (isRoot && !ValidRootMove(thread, move))
       continue;
-    if (!isRoot && !IsLegal(move, board))
+    if (!isRoot && !deferredIdx && !IsLegal(move, board))
       continue;
 
+    // Deferred quiets the picker would have left out since they were deferred
+    if (deferredIdx && skipQuiets && !IsCap(move) && PromoPT(move) != QUEEN)
+      continue;
+
+    if (abdada && legalMoves && !deferredIdx && numDeferred < 32 &&
+        SearchedElsewhere(thread, KeyAfter(board, move), depth)) {
+      deferred[numDeferred++] = move;
+      continue;
+    }
+
     uint64_t startingNodeCount = thread->nodes;
 
     legalMoves++;
 
     int extension       = 0;
     int killerOrCounter = move == mp.killer1 || move == mp.killer2 || move == mp.counter;
-    int history         = GetHistory(ss, thread, move);
+    int history         = IsCap(move) ? GetCaptureHistory(thread, move) : TablesQuietHistory(&tables, move);
 
     int R = LMR[Min(depth, 63)][Min(legalMoves, 63)];
     R -= history / 8192;                         // adjust reduction based on historical score
@@ -643,7 +982,7 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
 
     playedMoves++;
 
-    if (isRoot && !thread->idx && GetTimeMS() - Limits.start > 2500)
+    if (isRoot && !thread->idx && !Limits.quiet && GetTimeMS() - Limits.start > 2500)
       printf("info depth %d currmove %s currmovenumber %d\n",
              thread->depth,
              MoveToStr(move, board),
@@ -671,6 +1010,9 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
         score    = Negamax(sBeta - 1, sBeta, sDepth, cutnode, thread, pv, ss);
         ss->skip = NULL_MOVE;
 
+        if (thread->stopped)
+          return 0;
+
         // no score failed above sBeta, so this is singular
         if (score < sBeta) {
           if (!isPV && score < sBeta - 48 && ss->de <= 6 && !IsCap(move)) {
@@ -693,11 +1035,13 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
       }
     }
 
-    TTPrefetch(KeyAfter(board, move));
+    PrefetchChild(thread, board, move);
     ss->move = move;
-    ss->ch   = &thread->ch[IsCap(move)][Moving(move)][To(move)];
+    ss->ch   = &thread->ch[IsCap(move)][CHRow(Moving(move))][To(move)];
     MakeMove(move, board);
 
+    SearchingEntry* searching = abdada ? MarkSearching(thread, board->zobrist, depth) : NULL;
+
     // apply extensions
     int newDepth = depth + extension;
 
@@ -734,8 +1078,10 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
 
       int lmrDepth = newDepth - R;
       score        = -Negamax(-alpha - 1, -alpha, lmrDepth, 1, thread, &childPv, ss + 1);
+      StatsInc(thread, lmrSearches);
 
       if (score > alpha && R > 1) {
+        StatsInc(thread, lmrResearches);
         // Credit to Viz (and lonfom) for the following modification of the zws
         // re-search depth. They can be found in SF as doDeeperSearch + doShallowerSearch
         newDepth += (score > bestScore + 69);
@@ -745,7 +1091,8 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
           score = -Negamax(-alpha - 1, -alpha, newDepth - 1, !cutnode, thread, &childPv, ss + 1);
 
         int bonus = score <= alpha ? -HistoryBonus(newDepth - 1) : score >= beta ? HistoryBonus(newDepth - 1) : 0;
-        UpdateCH(ss, move, bonus);
+        if (!thread->stopped)
+          UpdateCH(ss, move, bonus);
       }
     } else if (!isPV || playedMoves > 1) {
       score = -Negamax(-alpha - 1, -alpha, newDepth - 1, !cutnode, thread, &childPv, ss + 1);
@@ -755,6 +1102,10 @@ int Negamax(int alpha, int beta, int depth, int cutnode, ThreadData* thread, PV*
       score = -Negamax(-beta, -alpha, newDepth - 1, 0, thread, &childPv, ss + 1);
 
     UndoMove(move, board);
+    ReleaseSearching(searching);
+
+    if (thread->stopped)
+      return 0;
 
     if (isRoot) {
       RootMove* rm = thread->rootMoves;
@@ -837,11 +1188,10 @@ int Quiesce(int alpha, int beta, int depth, ThreadData* thread, SearchStack* ss)
   Move bestMove = NULL_MOVE;
   Move move     = NULL_MOVE;
 
-  if (LoadRlx(Threads.stop) || (!thread->idx && CheckLimits(thread)))
-    // hot exit
-    longjmp(thread->exit, 1);
+  if (SearchStopped(thread))
+    return 0;
 
-  IncRlx(thread->nodes);
+  IncOwned(thread->nodes);
 
   // draw check
   if (IsDraw(board, ss->ply))
@@ -860,10 +1210,15 @@ int Quiesce(int alpha, int beta, int depth, ThreadData* thread, SearchStack* ss)
   int ttPv    = isPV;
 
   TTEntry* tt = TTProbe(board->zobrist, ss->ply, &ttHit, &hashMove, &ttScore, &ttEval, &ttDepth, &ttBound, &ttPv);
+  StatsInc(thread, ttProbes);
+  if (ttHit)
+    StatsInc(thread, ttHits);
 
   // TT score pruning, ttHit implied with adjusted score
-  if (!isPV && ttScore != UNKNOWN && (ttBound & (ttScore >= beta ? BOUND_LOWER : BOUND_UPPER)))
+  if (!isPV && ttScore != UNKNOWN && (ttBound & (ttScore >= beta ? BOUND_LOWER : BOUND_UPPER))) {
+    StatsInc(thread, ttCutoffs);
     return ttScore;
+  }
 
   if (inCheck) {
     rawEval = eval = ss->staticEval = EVAL_UNKNOWN;
@@ -933,15 +1288,18 @@ int Quiesce(int alpha, int beta, int depth, ThreadData* thread, SearchStack* ss)
     else if (IsCap(move) && numCaptures < 32)
       captures[numCaptures++] = move;
 
-    TTPrefetch(KeyAfter(board, move));
+    PrefetchChild(thread, board, move);
     ss->move = move;
-    ss->ch   = &thread->ch[IsCap(move)][Moving(move)][To(move)];
+    ss->ch   = &thread->ch[IsCap(move)][CHRow(Moving(move))][To(move)];
     MakeMove(move, board);
 
     score = -Quiesce(-beta, -alpha, depth - 1, thread, ss + 1);
 
     UndoMove(move, board);
 
+    if (thread->stopped)
+      return 0;
+
     if (score > -TB_WIN_BOUND)
       skipQuiets = 1;
 
@@ -974,6 +1332,14 @@ int Quiesce(int alpha, int beta, int depth, ThreadData* thread, SearchStack* ss)
 }
 
 void PrintUCI(ThreadData* thread, int alpha, int beta, Board* board) {
+  if (Limits.report) {
+    Limits.report(thread, board, alpha, beta, NULL_MOVE, NULL_MOVE);
+    return;
+  }
+
+  if (Limits.quiet)
+    return;
+
   int depth       = thread->depth;
   uint64_t nodes  = NodesSearched();
   uint64_t tbhits = TBHits();
@@ -981,7 +1347,7 @@ void PrintUCI(ThreadData* thread, int alpha, int beta, Board* board) {
   uint64_t nps    = 1000 * nodes / time;
   int hashfull    = TTFull();
 
-  for (int i = 0; i < Limits.multiPV; i++) {
+  for (int i = 0; i < Min(Limits.multiPV, thread->numRootMoves); i++) {
     int updated = (thread->rootMoves[i].score != -CHECKMATE);
     if (depth == 1 && i > 0 && !updated)
       break;
@@ -1065,14 +1431,19 @@ void SearchClearThread(ThreadData* thread) {
   memset(&thread->ch, 0, sizeof(thread->ch));
   memset(&thread->caph, 0, sizeof(thread->caph));
   memset(&thread->pawnCorrection, 0, sizeof(thread->pawnCorrection));
+  memset(&thread->evalCache, 0, sizeof(thread->evalCache));
 
-  thread->board.accumulators = thread->accumulators;
-  thread->previousScore      = UNKNOWN;
+  thread->board.accumulators      = thread->accumulators;
+  thread->board.smallAccumulators = thread->smallAccumulators;
+  thread->previousScore           = UNKNOWN;
 }
 
+// Synchronous, as StartSearch writes into the thread data. Call it before
+// TTClear so that it doesn't wait on the (much slower) TT clear.
 void SearchClear() {
-  for (int i = 0; i < Threads.count; i++)
-    ThreadWake(Threads.threads[i], THREAD_SEARCH_CLEAR);
-  for (int i = 0; i < Threads.count; i++)
-    ThreadWaitUntilSleep(Threads.threads[i]);
+  WARM.count = 0;
+  ClearSharedHistory();
+
+  ThreadsRun(THREAD_SEARCH_CLEAR);
+  ThreadsWait();
 }
@@ -28,8 +28,24 @@
 #define TB_WIN_SCORE MATE_BOUND
 #define TB_WIN_BOUND (TB_WIN_SCORE - MAX_SEARCH_PLY)
 
+// How helper threads are kept from repeating the main thread's work
+enum {
+  HELPER_POLICY_NONE,
+  HELPER_POLICY_SKIP,  // skip iterations in a pattern based on the thread index
+  HELPER_POLICY_WINDOW // start each iteration from a wider aspiration window
+};
+
+extern int HELPER_POLICY;
+extern int ABDADA;
+extern int WARM_START;
+extern int SEED_HELPERS;
+extern int MULTIPV_SPLIT;
+
+const char* HelperPolicyName();
+
 void InitPruningAndReductionTables();
 
+void SetSearchLimits(int depth, uint64_t nodes, int movetime, int multiPV);
 void StartSearch(Board* board, uint8_t ponder);
 void MainSearch();
 void Search(ThreadData* thread);
@@ -22,5 +22,6 @@
 extern const int SEE_VALUE[7];
 
 int SEE(Board* board, Move move, int threshold);
+void SEEBatch(Board* board, const ScoredMove* begin, const ScoredMove* end, const int* thresholds, int* results);
 
 #endif
\ No newline at end of file
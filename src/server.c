@@ -0,0 +1,391 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "server.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board.h"
+#include "move.h"
+#include "nn/evaluate.h"
+#include "search.h"
+#include "thread.h"
+#include "transposition.h"
+#include "types.h"
+#include "uci.h"
+#include "util.h"
+
+// Server mode runs many independent analyses through the one thread pool,
+// one at a time: it is a serial queue of sessions, not concurrent searches.
+// Each session owns a position, a (small) hash table and its search limits
+// (the NodesTime clock among them), everything else is shared: the networks,
+// the tablebases and the threads themselves.
+//
+// Input lines are "<id> <command>", where command is one of
+//   position ..., go ..., stop, ucinewgame, setoption name Hash value <mb>, close
+// Unprefixed "isready" and "quit" work as usual, the end of the input waits
+// for what is queued while quit stops it.
+//
+// Input is read all the time. Commands are queued and run in order, one
+// search at a time on all of the pool's threads, so a "go infinite" (or
+// ponder), or any long search, holds every other session until it is done.
+// Searching sessions side by side would need a pool (and the TT and limits
+// globals) per session, which the engine doesn't have. A stop reaches the
+// session's running search straight away, or makes its queued go return as
+// soon as it starts. Every block of search output is preceded by
+// "session <id>".
+
+typedef struct {
+  int id;
+  int hashMB;
+  TTTable tt;
+  SearchParams limits;
+  char position[8192];
+} Session;
+
+typedef struct Job {
+  struct Job* next;
+  int id;
+  int started, stopped; // under QUEUE_MUTEX
+  char command[];
+} Job;
+
+// Only the runner thread touches the sessions
+static Session** SESSIONS;
+static int SESSION_COUNT, SESSION_CAPACITY;
+static Session* LAST_SEARCHED;
+
+static pthread_mutex_t QUEUE_MUTEX = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t QUEUE_COND   = PTHREAD_COND_INITIALIZER;
+static Job *QUEUE_HEAD, *QUEUE_TAIL;
+static Job* RUNNING;
+static int INPUT_DONE, QUITTING;
+
+// The engine's own TT and limits while a session's are swapped in
+static TTTable ENGINE_TT;
+static SearchParams ENGINE_LIMITS;
+
+// Session the search output belongs to
+static int REPORT_ID;
+
+static void SessionEnter(Session* s) {
+  ENGINE_TT     = TT;
+  ENGINE_LIMITS = Limits;
+  TT            = s->tt;
+  Limits        = s->limits;
+}
+
+// TTClear runs in the background, it must be done before swapping out
+static void SessionLeave(Session* s) {
+  ThreadsWait();
+
+  s->tt     = TT;
+  s->limits = Limits;
+  TT        = ENGINE_TT;
+  Limits    = ENGINE_LIMITS;
+}
+
+static void SessionResize(Session* s, int mb) {
+  SessionEnter(s);
+  s->hashMB = (int) (TTInit(mb) / MEGABYTE);
+  SessionLeave(s);
+}
+
+static Session* SessionFind(int id) {
+  for (int i = 0; i < SESSION_COUNT; i++)
+    if (SESSIONS[i]->id == id)
+      return SESSIONS[i];
+
+  return NULL;
+}
+
+static Session* SessionCreate(int id) {
+  if (SESSION_COUNT == SESSION_CAPACITY) {
+    SESSION_CAPACITY = Max(16, 2 * SESSION_CAPACITY);
+    SESSIONS         = realloc(SESSIONS, SESSION_CAPACITY * sizeof(Session*));
+  }
+
+  Session* s = calloc(1, sizeof(Session));
+  s->id      = id;
+  strcpy(s->position, "position startpos");
+  SessionResize(s, SERVER_HASH_DEFAULT);
+
+  SESSIONS[SESSION_COUNT++] = s;
+  return s;
+}
+
+static void SessionClose(Session* s) {
+  SessionEnter(s);
+  TTFree();
+  SessionLeave(s);
+
+  if (LAST_SEARCHED == s)
+    LAST_SEARCHED = NULL;
+
+  for (int i = 0; i < SESSION_COUNT; i++)
+    if (SESSIONS[i] == s) {
+      SESSIONS[i] = SESSIONS[--SESSION_COUNT];
+      break;
+    }
+
+  free(s);
+}
+
+// Searches print through here, so that each block of output is preceded by
+// its session and can't interleave with anything the reader prints
+static void SessionReport(ThreadData* thread, Board* board, int alpha, int beta, Move bestMove, Move ponderMove) {
+  flockfile(stdout);
+  printf("session %d\n", REPORT_ID);
+
+  Limits.report = NULL;
+  if (bestMove) {
+    printf("bestmove %s", MoveToStr(bestMove, board));
+    if (ponderMove)
+      printf(" ponder %s", MoveToStr(ponderMove, board));
+    printf("\n");
+  } else {
+    PrintUCI(thread, alpha, beta, board);
+  }
+  Limits.report = SessionReport;
+
+  funlockfile(stdout);
+}
+
+static void SessionGo(Session* s, Job* job) {
+  Board board;
+  char position[8192];
+  strcpy(position, s->position);
+  ParsePosition(position, &board);
+
+  // Histories learnt on another session's position would make results depend
+  // on the order requests arrive in
+  if (LAST_SEARCHED != s)
+    SearchClear();
+  LAST_SEARCHED = s;
+
+  SessionEnter(s);
+
+  // ParseGo leaves the report alone, and the search can't print before
+  // stdout is unlocked
+  REPORT_ID     = s->id;
+  Limits.report = SessionReport;
+  flockfile(stdout);
+  printf("session %d\n", s->id);
+  ParseGo(job->command, &board);
+  funlockfile(stdout);
+
+  // A stop that came before the search had started
+  pthread_mutex_lock(&QUEUE_MUTEX);
+  job->started = 1;
+  if (job->stopped)
+    StopSearch();
+  pthread_mutex_unlock(&QUEUE_MUTEX);
+
+  ThreadWaitUntilSleep(Threads.threads[0]);
+
+  Limits.report = NULL;
+  SessionLeave(s);
+}
+
+static void SessionCommand(Job* job) {
+  Session* s = SessionFind(job->id);
+  char* in   = job->command;
+
+  if (!strncmp(in, "close", 5)) {
+    if (s)
+      SessionClose(s);
+    return;
+  }
+
+  if (!s)
+    s = SessionCreate(job->id);
+
+  if (!strncmp(in, "position", 8)) {
+    snprintf(s->position, sizeof(s->position), "%s", in);
+  } else if (!strncmp(in, "go", 2)) {
+    SessionGo(s, job);
+  } else if (!strncmp(in, "ucinewgame", 10)) {
+    strcpy(s->position, "position startpos");
+    s->limits.nodesLeft = 0;
+
+    SessionEnter(s);
+    TTClear();
+    SessionLeave(s);
+
+    if (LAST_SEARCHED == s)
+      LAST_SEARCHED = NULL;
+  } else if (!strncmp(in, "setoption name Hash value ", 26)) {
+    int n = GetOptionIntValue(in);
+
+    SessionResize(s, Max(1, Min(HASH_MAX, n)));
+    printf("session %d\ninfo string set Hash to %dMB\n", s->id, s->hashMB);
+  } else {
+    printf("session %d\ninfo string unknown session command: %s\n", s->id, in);
+  }
+}
+
+// Runs the queued commands in order until the input is done and the queue
+// empty, or a quit
+static void* ServerRunner(void* arg) {
+  (void) arg;
+
+  pthread_mutex_lock(&QUEUE_MUTEX);
+  while (1) {
+    while (!QUEUE_HEAD && !INPUT_DONE)
+      pthread_cond_wait(&QUEUE_COND, &QUEUE_MUTEX);
+
+    Job* job = QUEUE_HEAD;
+    if (!job || QUITTING)
+      break;
+
+    QUEUE_HEAD = job->next;
+    if (!QUEUE_HEAD)
+      QUEUE_TAIL = NULL;
+    RUNNING = job;
+    pthread_mutex_unlock(&QUEUE_MUTEX);
+
+    SessionCommand(job);
+
+    pthread_mutex_lock(&QUEUE_MUTEX);
+    RUNNING = NULL;
+    free(job);
+  }
+  pthread_mutex_unlock(&QUEUE_MUTEX);
+
+  return NULL;
+}
+
+static void ServerQueue(int id, char* command) {
+  Job* job = calloc(1, sizeof(Job) + strlen(command) + 1);
+  job->id  = id;
+  strcpy(job->command, command);
+
+  pthread_mutex_lock(&QUEUE_MUTEX);
+  if (QUEUE_TAIL)
+    QUEUE_TAIL->next = job;
+  else
+    QUEUE_HEAD = job;
+  QUEUE_TAIL = job;
+  pthread_cond_signal(&QUEUE_COND);
+  pthread_mutex_unlock(&QUEUE_MUTEX);
+}
+
+// Stop the session's running search and any go of it still queued
+static void ServerStop(int id) {
+  pthread_mutex_lock(&QUEUE_MUTEX);
+  for (Job* job = QUEUE_HEAD; job; job = job->next)
+    if (job->id == id)
+      job->stopped = 1;
+
+  if (RUNNING && RUNNING->id == id) {
+    RUNNING->stopped = 1;
+    if (RUNNING->started)
+      StopSearch();
+  }
+  pthread_mutex_unlock(&QUEUE_MUTEX);
+}
+
+// Stop everything, drop what is queued and let the runner exit
+static void ServerQuit() {
+  pthread_mutex_lock(&QUEUE_MUTEX);
+  QUITTING = INPUT_DONE = 1;
+
+  if (RUNNING) {
+    RUNNING->stopped = 1;
+    if (RUNNING->started)
+      StopSearch();
+  }
+
+  while (QUEUE_HEAD) {
+    Job* job   = QUEUE_HEAD;
+    QUEUE_HEAD = job->next;
+    free(job);
+  }
+  QUEUE_TAIL = NULL;
+
+  pthread_cond_signal(&QUEUE_COND);
+  pthread_mutex_unlock(&QUEUE_MUTEX);
+}
+
+void ServerLoop() {
+  static char in[8192];
+
+  // Sessions bring their own tables, the engine's isn't needed meanwhile
+  const int engineMB = TT.mem ? (int) (TT.size / MEGABYTE) : 0;
+  if (TT.mem)
+    TTFree();
+  if (!NETWORK.hidden)
+    LoadDefaultNN();
+
+  INPUT_DONE = QUITTING = 0;
+
+  pthread_t runner;
+  pthread_create(&runner, NULL, ServerRunner, NULL);
+
+  printf("info string server mode, lines are \"<id> <command>\"\n");
+  printf("info string sessions are queued and searched one at a time on all threads, a long search holds the rest\n");
+
+  int quit = 0;
+  while (!quit && ReadLine(in)) {
+    if (in[0] == '\0')
+      continue;
+
+    char* cmd = in;
+    long id   = strtol(in, &cmd, 10);
+
+    if (cmd == in) {
+      if (!strncmp(in, "isready", 7))
+        printf("readyok\n");
+      else if (!strncmp(in, "quit", 4))
+        quit = 1;
+      else
+        printf("info string unknown server command: %s\n", in);
+
+      continue;
+    }
+
+    cmd += strspn(cmd, " ");
+    if (!strncmp(cmd, "stop", 4))
+      ServerStop((int) id);
+    else
+      ServerQueue((int) id, cmd);
+  }
+
+  if (quit)
+    ServerQuit();
+  else {
+    pthread_mutex_lock(&QUEUE_MUTEX);
+    INPUT_DONE = 1;
+    pthread_cond_signal(&QUEUE_COND);
+    pthread_mutex_unlock(&QUEUE_MUTEX);
+  }
+
+  pthread_join(runner, NULL);
+
+  while (SESSION_COUNT)
+    SessionClose(SESSIONS[0]);
+
+  free(SESSIONS);
+  SESSIONS         = NULL;
+  SESSION_CAPACITY = 0;
+
+  if (engineMB)
+    TTInit(engineMB);
+}
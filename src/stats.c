@@ -0,0 +1,136 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "stats.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "search.h"
+#include "thread.h"
+#include "transposition.h"
+#include "types.h"
+#include "util.h"
+
+void StatsClear() {
+  for (int i = 0; i < Threads.count; i++)
+    memset(&Threads.threads[i]->stats, 0, sizeof(Stats));
+
+  TT.changed = 0;
+}
+
+#if defined(STATS)
+static void PrintCounter(const char* name, uint64_t count, uint64_t total) {
+  if (total)
+    printf("info string stats %-20s %14" PRIu64 " (%.4f%%)\n", name, count, 100.0 * count / total);
+  else
+    printf("info string stats %-20s %14" PRIu64 "\n", name, count);
+}
+#endif
+
+void StatsPrint() {
+#if defined(STATS)
+  Stats total = {0};
+
+  for (int i = 0; i < Threads.count; i++) {
+    Stats* s = &Threads.threads[i]->stats;
+
+    total.ttProbes += s->ttProbes;
+    total.hashMoves += s->hashMoves;
+    total.hashMovesIllegal += s->hashMovesIllegal;
+    total.nnLazyUpdates += s->nnLazyUpdates;
+    total.nnLazyPlies += s->nnLazyPlies;
+    total.nnRefreshes += s->nnRefreshes;
+    total.nnRefreshFeatures += s->nnRefreshFeatures;
+    total.evalCacheProbes += s->evalCacheProbes;
+    total.evalCacheHits += s->evalCacheHits;
+    total.nnSmallEvals += s->nnSmallEvals;
+    total.mpScored += s->mpScored;
+    total.mpPicked += s->mpPicked;
+    total.mpQuietGathers += s->mpQuietGathers;
+    total.mpQuietLines += s->mpQuietLines;
+    total.tbCacheProbes += s->tbCacheProbes;
+    total.tbCacheHits += s->tbCacheHits;
+    total.ttHits += s->ttHits;
+    total.ttCutoffs += s->ttCutoffs;
+    total.mpPickers += s->mpPickers;
+    total.mpNoisy += s->mpNoisy;
+    total.mpKillers += s->mpKillers;
+    total.mpQuiets += s->mpQuiets;
+    total.mpBadNoisy += s->mpBadNoisy;
+    total.mpProbcut += s->mpProbcut;
+    total.mpQsNoisy += s->mpQsNoisy;
+    total.mpQsChecks += s->mpQsChecks;
+    total.mpEvasions += s->mpEvasions;
+    total.mpEvasionQuiets += s->mpEvasionQuiets;
+    total.tbProbes += s->tbProbes;
+    total.cycleChecks += s->cycleChecks;
+    total.cycleHits += s->cycleHits;
+    total.nmpTries += s->nmpTries;
+    total.nmpCutoffs += s->nmpCutoffs;
+    total.nmpVerifies += s->nmpVerifies;
+    total.lmrSearches += s->lmrSearches;
+    total.lmrResearches += s->lmrResearches;
+    total.pcTries += s->pcTries;
+    total.pcCutoffs += s->pcCutoffs;
+  }
+
+  const uint64_t nnUpdates = total.nnLazyUpdates + total.nnRefreshes;
+
+  PrintCounter("ttProbes", total.ttProbes, 0);
+  PrintCounter("ttHits", total.ttHits, total.ttProbes);
+  PrintCounter("ttCutoffs", total.ttCutoffs, total.ttProbes);
+  PrintCounter("ttChanged", LoadRlx(TT.changed), total.ttProbes);
+  PrintCounter("hashMoves", total.hashMoves, 0);
+  PrintCounter("hashMovesIllegal", total.hashMovesIllegal, total.hashMoves + total.hashMovesIllegal);
+  PrintCounter("nnLazyUpdates", total.nnLazyUpdates, nnUpdates);
+  PrintCounter("nnLazyPlies", total.nnLazyPlies, 0);
+  PrintCounter("nnRefreshes", total.nnRefreshes, nnUpdates);
+  PrintCounter("nnRefreshFeatures", total.nnRefreshFeatures, 0);
+  PrintCounter("evalCacheProbes", total.evalCacheProbes, 0);
+  PrintCounter("evalCacheHits", total.evalCacheHits, total.evalCacheProbes);
+  PrintCounter("nnSmallEvals", total.nnSmallEvals, total.evalCacheProbes - total.evalCacheHits);
+  PrintCounter("mpScored", total.mpScored, 0);
+  PrintCounter("mpUnpicked", total.mpScored - total.mpPicked, total.mpScored);
+  PrintCounter("mpQuietGathers", total.mpQuietGathers, 0);
+  PrintCounter("mpQuietLines", total.mpQuietLines, total.mpQuietGathers);
+  PrintCounter("mpPickers", total.mpPickers, 0);
+  PrintCounter("mpNoisy", total.mpNoisy, total.mpPickers);
+  PrintCounter("mpKillers", total.mpKillers, total.mpPickers);
+  PrintCounter("mpQuiets", total.mpQuiets, total.mpPickers);
+  PrintCounter("mpBadNoisy", total.mpBadNoisy, total.mpPickers);
+  PrintCounter("mpProbcut", total.mpProbcut, 0);
+  PrintCounter("mpQsNoisy", total.mpQsNoisy, 0);
+  PrintCounter("mpQsChecks", total.mpQsChecks, total.mpQsNoisy);
+  PrintCounter("mpEvasions", total.mpEvasions, 0);
+  PrintCounter("mpEvasionQuiets", total.mpEvasionQuiets, total.mpEvasions);
+  PrintCounter("cycleChecks", total.cycleChecks, 0);
+  PrintCounter("cycleHits", total.cycleHits, total.cycleChecks);
+  PrintCounter("nmpTries", total.nmpTries, 0);
+  PrintCounter("nmpCutoffs", total.nmpCutoffs, total.nmpTries);
+  PrintCounter("nmpVerifies", total.nmpVerifies, total.nmpTries);
+  PrintCounter("lmrSearches", total.lmrSearches, 0);
+  PrintCounter("lmrResearches", total.lmrResearches, total.lmrSearches);
+  PrintCounter("pcTries", total.pcTries, 0);
+  PrintCounter("pcCutoffs", total.pcCutoffs, total.pcTries);
+  PrintCounter("tbProbes", total.tbProbes, 0);
+  PrintCounter("tbCacheProbes", total.tbCacheProbes, 0);
+  PrintCounter("tbCacheHits", total.tbCacheHits, total.tbCacheProbes);
+#else
+  printf("info string stats are only collected by STATS=1 builds\n");
+#endif
+}
@@ -0,0 +1,34 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "types.h"
+
+// Counters are compiled in with `make STATS=1` and cost nothing otherwise
+#if defined(STATS)
+#define StatsInc(thread, counter)    ((thread)->stats.counter++)
+#define StatsAdd(thread, counter, n) ((thread)->stats.counter += (n))
+#else
+#define StatsInc(thread, counter)    ((void) (thread))
+#define StatsAdd(thread, counter, n) ((void) (thread), (void) (n))
+#endif
+
+void StatsClear();
+void StatsPrint();
+
+#endif
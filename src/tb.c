@@ -16,16 +16,153 @@
 
 #include "tb.h"
 
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "board.h"
 #include "move.h"
 #include "movegen.h"
 #include "pyrrhic/tbprobe.h"
+#include "stats.h"
 
 #define ByteSwap(bb) __builtin_bswap64((bb))
 
+// WDL results are exact, so a single cache is shared by every thread and search.
+// Entries hold the upper bits of the zobrist key with the result + 1 in the lowest 3
+#define TB_CACHE_SIZE 65536
+#define TB_CACHE_MASK 7ULL
+
+static _Atomic uint64_t TB_CACHE[TB_CACHE_SIZE];
+
+int TB_PROBE_DEPTH = 1;
+int TB_PROBE_LIMIT = 7;
+int TB_PRELOAD     = 0;
+int TB_LOCK        = 0;
+
+// tb_init opens and maps every file on the path, which takes a while for a
+// full 7-man set, so it runs in the background until the tables are needed
+static pthread_t TB_INIT_THREAD;
+static int TB_INIT_RUNNING = 0;
+static char* TB_INIT_PATH  = NULL;
+
+// A DTZ root probe can have to map and decompress from the large DTZ files,
+// so the search starts on every legal move and narrows them once it's done
+static pthread_t TB_ROOT_THREAD;
+static int TB_ROOT_RUNNING = 0;
+static atomic_int TB_ROOT_READY;
+static Board TB_ROOT_BOARD;
+static SimpleMoveList TB_ROOT_MOVES;
+
+static void PreloadTables() {
+  if (!TB_LARGEST || !TB_PRELOAD)
+    return;
+
+  size_t bytes = tb_preload(TB_PRELOAD, TB_LOCK);
+  printf("info string %s %zu KB of up to %d-men WDL tables\n", TB_LOCK ? "Locked" : "Loaded", bytes >> 10, TB_PRELOAD);
+}
+
+void TBPreload() {
+  TBWaitForInit();
+  PreloadTables();
+}
+
+static void* TBInitThread(void* arg) {
+  (void) arg;
+
+  if (tb_init(TB_INIT_PATH)) {
+    printf("info string set SyzygyPath to value %s\n", TB_INIT_PATH);
+    PreloadTables();
+  } else
+    printf("info string FAILED!\n");
+
+  return NULL;
+}
+
+void TBInit(char* path) {
+  TBWaitForInit();
+
+  free(TB_INIT_PATH);
+  TB_INIT_PATH = strdup(path);
+  TBCacheClear();
+
+  TB_INIT_RUNNING = !pthread_create(&TB_INIT_THREAD, NULL, TBInitThread, NULL);
+  if (!TB_INIT_RUNNING)
+    TBInitThread(NULL);
+}
+
+void TBWaitForInit() {
+  if (!TB_INIT_RUNNING)
+    return;
+
+  pthread_join(TB_INIT_THREAD, NULL);
+  TB_INIT_RUNNING = 0;
+}
+
+static void* TBRootThread(void* arg) {
+  (void) arg;
+
+  TBRootMoves(&TB_ROOT_MOVES, &TB_ROOT_BOARD);
+  atomic_store_explicit(&TB_ROOT_READY, 1, memory_order_release);
+
+  return NULL;
+}
+
+void TBRootProbeStart(Board* board) {
+  TBRootProbeWait();
+
+  TB_ROOT_MOVES.count = 0;
+  atomic_store_explicit(&TB_ROOT_READY, 0, memory_order_relaxed);
+
+  // Nothing to wait on unless the root is in the tables
+  if (board->castling || BitCount(OccBB(BOTH)) > Min(TB_LARGEST, TB_PROBE_LIMIT)) {
+    atomic_store_explicit(&TB_ROOT_READY, 1, memory_order_relaxed);
+    return;
+  }
+
+  memcpy(&TB_ROOT_BOARD, board, offsetof(Board, accumulators));
+
+  TB_ROOT_RUNNING = !pthread_create(&TB_ROOT_THREAD, NULL, TBRootThread, NULL);
+  if (!TB_ROOT_RUNNING)
+    TBRootThread(NULL);
+}
+
+void TBRootProbeWait() {
+  if (!TB_ROOT_RUNNING)
+    return;
+
+  pthread_join(TB_ROOT_THREAD, NULL);
+  TB_ROOT_RUNNING = 0;
+}
+
+int TBRootProbeReady() {
+  return atomic_load_explicit(&TB_ROOT_READY, memory_order_acquire);
+}
+
+// Drops the root moves that don't preserve the DTZ result, keeping the order
+// (and scores) of the rest. Must only be called once TBRootProbeReady()
+void TBFilterRootMoves(ThreadData* thread) {
+  if (!TB_ROOT_MOVES.count)
+    return;
+
+  int count = 0;
+  for (int i = 0; i < thread->numRootMoves; i++)
+    for (int j = 0; j < TB_ROOT_MOVES.count; j++)
+      if (thread->rootMoves[i].move == TB_ROOT_MOVES.moves[j]) {
+        thread->rootMoves[count++] = thread->rootMoves[i];
+        break;
+      }
+
+  thread->numRootMoves = count;
+}
+
+void TBCacheClear() {
+  for (int i = 0; i < TB_CACHE_SIZE; i++)
+    atomic_store_explicit(&TB_CACHE[i], 0, memory_order_relaxed);
+}
+
 void TBRootMoves(SimpleMoveList* moves, Board* board) {
   moves->count = 0;
 
@@ -43,7 +180,7 @@ void TBRootMoves(SimpleMoveList* moves, Board* board) {
 }
 
 unsigned TBRootProbe(Board* board, unsigned* results) {
-  if (board->castling || BitCount(OccBB(BOTH)) > TB_LARGEST)
+  if (board->castling || BitCount(OccBB(BOTH)) > Min(TB_LARGEST, TB_PROBE_LIMIT))
     return TB_RESULT_FAILED;
 
   return tb_probe_root(ByteSwap(OccBB(WHITE)),
@@ -60,11 +197,22 @@ unsigned TBRootProbe(Board* board, unsigned* results) {
                        results);
 }
 
-unsigned TBProbe(Board* board) {
-  if (board->castling || board->fmr || BitCount(OccBB(BOTH)) > TB_LARGEST)
+unsigned TBProbe(Board* board, ThreadData* thread) {
+  StatsInc(thread, tbProbes);
+
+  if (board->castling || board->fmr || BitCount(OccBB(BOTH)) > Min(TB_LARGEST, TB_PROBE_LIMIT))
     return TB_RESULT_FAILED;
 
-  return tb_probe_wdl(ByteSwap(OccBB(WHITE)),
+  _Atomic uint64_t* slot = &TB_CACHE[board->zobrist & (TB_CACHE_SIZE - 1)];
+  const uint64_t entry   = LoadRlx(*slot);
+
+  StatsInc(thread, tbCacheProbes);
+  if ((entry & TB_CACHE_MASK) && (entry & ~TB_CACHE_MASK) == (board->zobrist & ~TB_CACHE_MASK)) {
+    StatsInc(thread, tbCacheHits);
+    return (entry & TB_CACHE_MASK) - 1;
+  }
+
+  unsigned result = tb_probe_wdl(ByteSwap(OccBB(WHITE)),
                       ByteSwap(OccBB(BLACK)),
                       ByteSwap(PieceBB(KING, WHITE) | PieceBB(KING, BLACK)),
                       ByteSwap(PieceBB(QUEEN, WHITE) | PieceBB(QUEEN, BLACK)),
@@ -74,4 +222,9 @@ unsigned TBProbe(Board* board) {
                       ByteSwap(PieceBB(PAWN, WHITE) | PieceBB(PAWN, BLACK)),
                       board->epSquare ? (board->epSquare ^ 56) : 0,
                       board->stm == WHITE ? 1 : 0);
+
+  if (result != TB_RESULT_FAILED)
+    atomic_store_explicit(slot, (board->zobrist & ~TB_CACHE_MASK) | (result + 1), memory_order_relaxed);
+
+  return result;
 }
\ No newline at end of file
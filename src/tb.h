@@ -51,6 +51,19 @@ INLINE Move TBMoveFromResult(unsigned res, Board* board) {
 
 void TBRootMoves(SimpleMoveList* moves, Board* board);
 unsigned TBRootProbe(Board* board, unsigned* results);
-unsigned TBProbe(Board* board);
+extern int TB_PROBE_DEPTH;
+extern int TB_PROBE_LIMIT;
+extern int TB_PRELOAD;
+extern int TB_LOCK;
+
+void TBInit(char* path);
+void TBWaitForInit();
+void TBCacheClear();
+void TBPreload();
+void TBRootProbeStart(Board* board);
+void TBRootProbeWait();
+int TBRootProbeReady();
+void TBFilterRootMoves(ThreadData* thread);
+unsigned TBProbe(Board* board, ThreadData* thread);
 
 #endif
\ No newline at end of file
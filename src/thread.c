@@ -22,10 +22,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "datagen.h"
 #include "eval.h"
+#include "history.h"
 #include "nn/accumulator.h"
+#include "nn/evaluate.h"
+#include "numa.h"
+#include "perft.h"
 #include "search.h"
 #include "tb.h"
+#include "trace.h"
 #include "transposition.h"
 #include "types.h"
 #include "uci.h"
@@ -58,72 +64,244 @@ void ThreadWait(ThreadData* thread, atomic_uchar* cond) {
   pthread_mutex_unlock(&thread->mutex);
 }
 
-// Wake a thread up with an action
-void ThreadWake(ThreadData* thread, int action) {
+// Idle threads spin this many pauses over the action before blocking, so an
+// action handed out right after the previous one finished (the next search
+// in a bench or game, a clear then a search) starts without a wakeup syscall.
+// Only when every thread has a cpu of its own, otherwise the spinning takes
+// time from the threads still working.
+#define IDLE_SPINS 2048
+
+INLINE void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+INLINE int IsIdle(ThreadData* thread) {
+  return __atomic_load_n(&thread->action, __ATOMIC_ACQUIRE) == THREAD_SLEEP;
+}
+
+// Every idle thread blocks on the one pool condition, so however many
+// threads are handed an action they are all woken by a single broadcast
+static void ThreadsWakeIdle() {
+  pthread_mutex_lock(&Threads.mutex);
+  pthread_cond_broadcast(&Threads.wake);
+  pthread_mutex_unlock(&Threads.mutex);
+}
+
+// Hand a thread an action, after it has finished any previous one. It is
+// only woken by the next ThreadsWakeIdle.
+static void ThreadAssign(ThreadData* thread, int action) {
   pthread_mutex_lock(&thread->mutex);
 
-  if (action != THREAD_RESUME)
-    thread->action = action;
+  while (thread->action != THREAD_SLEEP)
+    pthread_cond_wait(&thread->sleep, &thread->mutex);
 
-  pthread_cond_signal(&thread->sleep);
+  __atomic_store_n(&thread->action, action, __ATOMIC_RELEASE);
   pthread_mutex_unlock(&thread->mutex);
 }
 
+// Hand threads [from, count) an action, in order, and wake them together.
+// Before waiting on a thread still busy with an earlier action, the ones
+// already handed theirs are started.
+static void ThreadsAssign(int from, int action) {
+  int assigned = 0;
+
+  for (int i = from; i < Threads.count; i++) {
+    ThreadData* thread = Threads.threads[i];
+
+    if (assigned && !IsIdle(thread)) {
+      ThreadsWakeIdle();
+      assigned = 0;
+    }
+
+    ThreadAssign(thread, action);
+    assigned = 1;
+  }
+
+  if (assigned)
+    ThreadsWakeIdle();
+}
+
+// Wake a thread up with an action, after it has finished any previous one
+void ThreadWake(ThreadData* thread, int action) {
+  if (action == THREAD_RESUME) {
+    pthread_mutex_lock(&thread->mutex);
+    pthread_cond_signal(&thread->sleep);
+    pthread_mutex_unlock(&thread->mutex);
+    return;
+  }
+
+  ThreadAssign(thread, action);
+  ThreadsWakeIdle();
+}
+
+// Start the same action on every helper at once (the main thread is running)
+void ThreadsWakeHelpers(int action) {
+  ThreadsAssign(1, action);
+}
+
+// Mark the action started by ThreadsRun as done for this thread
+static void ThreadDone(ThreadData* thread) {
+  thread->action = THREAD_SLEEP;
+
+  pthread_mutex_lock(&Threads.mutex);
+  if (!--Threads.pending)
+    pthread_cond_broadcast(&Threads.done);
+  pthread_mutex_unlock(&Threads.mutex);
+}
+
+// Spin for a new action for a little while, then block until one comes
+static void ThreadSleep(ThreadData* thread) {
+  const int spins = Threads.spin ? IDLE_SPINS : 0;
+  for (int i = 0; i < spins && IsIdle(thread); i++)
+    CpuRelax();
+
+  if (!IsIdle(thread))
+    return;
+
+  pthread_mutex_lock(&Threads.mutex);
+  while (IsIdle(thread))
+    pthread_cond_wait(&Threads.wake, &Threads.mutex);
+  pthread_mutex_unlock(&Threads.mutex);
+}
+
 // Idle loop that wakes into an action
 void ThreadIdle(ThreadData* thread) {
   while (1) {
-    pthread_mutex_lock(&thread->mutex);
-
-    while (thread->action == THREAD_SLEEP) {
-      pthread_cond_signal(&thread->sleep);
-      pthread_cond_wait(&thread->sleep, &thread->mutex);
-    }
+    TraceBegin(thread, "sleep", 0);
 
+    // Anyone waiting for this thread to be done can go ahead
+    pthread_mutex_lock(&thread->mutex);
+    pthread_cond_broadcast(&thread->sleep);
     pthread_mutex_unlock(&thread->mutex);
 
+    ThreadSleep(thread);
+    TraceEnd(thread, "sleep");
+
     if (thread->action == THREAD_EXIT)
       break;
     else if (thread->action == THREAD_TT_CLEAR) {
+      TraceBegin(thread, "tt clear", 0);
       TTClearPart(thread->idx);
+      TraceEnd(thread, "tt clear");
+      ThreadDone(thread);
     } else if (thread->action == THREAD_SEARCH_CLEAR) {
+      TraceBegin(thread, "search clear", 0);
       SearchClearThread(thread);
+      TraceEnd(thread, "search clear");
+      ThreadDone(thread);
+    } else if (thread->action == THREAD_PERFT) {
+      TraceBegin(thread, "perft", 0);
+      PerftThread(thread);
+      TraceEnd(thread, "perft");
+      ThreadDone(thread);
+    } else if (thread->action == THREAD_DATAGEN) {
+      TraceBegin(thread, "datagen", 0);
+      DatagenThread(thread);
+      TraceEnd(thread, "datagen");
+      ThreadDone(thread);
     } else {
+      TraceBegin(thread, "search", thread->idx);
       if (thread->idx)
         Search(thread);
       else
         MainSearch();
+      TraceEnd(thread, "search");
+
+      thread->action = THREAD_SLEEP;
     }
+  }
+}
+
+// Run an action on every thread without waiting for it to complete.
+// Anything waking a thread afterwards waits for its part to finish first.
+void ThreadsRun(int action) {
+  pthread_mutex_lock(&Threads.mutex);
+  Threads.pending += Threads.count;
+  pthread_mutex_unlock(&Threads.mutex);
+
+  ThreadsAssign(0, action);
+}
+
+// Block until everything started with ThreadsRun has completed
+void ThreadsWait() {
+  pthread_mutex_lock(&Threads.mutex);
+  while (Threads.pending)
+    pthread_cond_wait(&Threads.done, &Threads.mutex);
+  pthread_mutex_unlock(&Threads.mutex);
+}
 
-    thread->action = THREAD_SLEEP;
+#define ACCUMULATORS_SIZE  (sizeof(Accumulator) * (MAX_SEARCH_PLY + 1))
+#define REFRESH_TABLE_SIZE (sizeof(AccumulatorKingState) * 2 * 2 * N_KING_BUCKETS)
+
+// The small network gets a stack and refresh table of its own while it is
+// loaded. Otherwise its stack is the network's, MakeMove only writes the same
+// move bookkeeping into it twice
+static void ThreadSmallNetworkMemory(ThreadData* thread) {
+  if (thread->smallNnMem && !SMALL_NETWORK.hidden) {
+    LargePagesFree(thread->smallNnMem, thread->nnMemSize, thread->smallNnMemPages);
+    thread->smallNnMem = NULL;
+  } else if (!thread->smallNnMem && SMALL_NETWORK.hidden) {
+    thread->smallNnMem = LargePagesAlloc(thread->nnMemSize, &thread->smallNnMemPages);
+  }
+
+  if (thread->smallNnMem) {
+    thread->smallAccumulators = (Accumulator*) thread->smallNnMem;
+    thread->smallRefreshTable = (AccumulatorKingState*) ((char*) thread->smallNnMem + ACCUMULATORS_SIZE);
+    ResetRefreshTable(&SMALL_NETWORK, thread->smallRefreshTable);
+  } else {
+    thread->smallAccumulators = thread->accumulators;
+    thread->smallRefreshTable = NULL;
   }
+
+  // Only changed while idle, with the board at its root
+  thread->board.accumulators      = thread->accumulators;
+  thread->board.smallAccumulators = thread->smallAccumulators;
+  thread->board.smallRefreshTable = thread->smallRefreshTable;
+}
+
+// Follow a small network being loaded or unloaded
+void ThreadsSmallNetworkMemory() {
+  for (int i = 0; i < Threads.count; i++)
+    ThreadSmallNetworkMemory(Threads.threads[i]);
 }
 
 // Build a thread
 void* ThreadInit(void* arg) {
   int i = (intptr_t) arg;
 
-  ThreadData* thread = calloc(1, sizeof(ThreadData));
-  thread->idx        = i;
+  // Pin before allocating so that all of the thread's memory is
+  // first-touched (and therefore placed) on its local NUMA node
+  NumaBindThread(i);
 
-#if defined(__linux__)
-  const size_t alignment = MEGABYTE * 2;
-#else
-  const size_t alignment = 4096;
-#endif
+  ThreadData* thread = AlignedMalloc(sizeof(ThreadData), 64);
+  memset(thread, 0, sizeof(ThreadData));
+  thread->idx = i;
 
-  // Alloc all the necessary accumulators
-  thread->accumulators = (Accumulator*) AlignedMalloc(sizeof(Accumulator) * (MAX_SEARCH_PLY + 1), alignment);
-  thread->refreshTable =
-    (AccumulatorKingState*) AlignedMalloc(sizeof(AccumulatorKingState) * 2 * 2 * N_KING_BUCKETS, alignment);
-  ResetRefreshTable(thread->refreshTable);
+  // Alloc all the necessary accumulators, sharing one (possibly huge page) block
+  thread->nnMemSize    = ACCUMULATORS_SIZE + REFRESH_TABLE_SIZE;
+  thread->nnMem        = LargePagesAlloc(thread->nnMemSize, &thread->nnMemPages);
+  thread->accumulators = (Accumulator*) thread->nnMem;
+  thread->refreshTable = (AccumulatorKingState*) ((char*) thread->nnMem + ACCUMULATORS_SIZE);
+  // LargePagesAlloc hands back zeroed memory, the accumulators are left to be
+  // faulted in by the first search rather than at startup
+  ResetRefreshTable(&NETWORK, thread->refreshTable);
 
   // Copy these onto the board for easier access within the engine
   thread->board.accumulators = thread->accumulators;
   thread->board.refreshTable = thread->refreshTable;
 
+  ThreadSmallNetworkMemory(thread);
+
   pthread_mutex_init(&thread->mutex, NULL);
   pthread_cond_init(&thread->sleep, NULL);
 
+  if (TRACING)
+    TraceAlloc(thread);
+
   Threads.threads[i] = thread;
 
   pthread_mutex_lock(&Threads.mutex);
@@ -153,28 +331,34 @@ void ThreadCreate(int i) {
 
 // Teardown and free a thread
 void ThreadDestroy(ThreadData* thread) {
-  pthread_mutex_lock(&thread->mutex);
-  thread->action = THREAD_EXIT;
-  pthread_cond_signal(&thread->sleep);
-  pthread_mutex_unlock(&thread->mutex);
+  ThreadWake(thread, THREAD_EXIT);
 
   pthread_join(thread->nativeThread, NULL);
   pthread_cond_destroy(&thread->sleep);
   pthread_mutex_destroy(&thread->mutex);
 
-  AlignedFree(thread->accumulators);
-  AlignedFree(thread->refreshTable);
+  LargePagesFree(thread->nnMem, thread->nnMemSize, thread->nnMemPages);
+  LargePagesFree(thread->smallNnMem, thread->nnMemSize, thread->smallNnMemPages);
+  TraceFree(thread);
 
-  free(thread);
+  AlignedFree(thread);
 }
 
 // Build the pool to a certain amnt
 void ThreadsSetNumber(int n) {
+  // Work started with ThreadsRun is split by the current count, and a search
+  // winding down after a stop still joins the current helpers
+  ThreadsWait();
+  WaitForSearch();
+
   while (Threads.count < n)
     ThreadCreate(Threads.count++);
   while (Threads.count > n)
     ThreadDestroy(Threads.threads[--Threads.count]);
 
+  // Leave a cpu for the uci thread
+  Threads.spin = Threads.count < OnlineCpus();
+
   if (n == 0)
     Threads.searching = 0;
 }
@@ -184,6 +368,8 @@ void ThreadsExit() {
   ThreadsSetNumber(0);
 
   pthread_cond_destroy(&Threads.sleep);
+  pthread_cond_destroy(&Threads.wake);
+  pthread_cond_destroy(&Threads.done);
   pthread_mutex_destroy(&Threads.mutex);
 }
 
@@ -191,8 +377,11 @@ void ThreadsExit() {
 void ThreadsInit() {
   pthread_mutex_init(&Threads.mutex, NULL);
   pthread_cond_init(&Threads.sleep, NULL);
+  pthread_cond_init(&Threads.wake, NULL);
+  pthread_cond_init(&Threads.done, NULL);
 
   Threads.count = 1;
+  Threads.spin  = Threads.count < OnlineCpus();
   ThreadCreate(0);
 }
 
@@ -213,6 +402,7 @@ void SetupMainThread(Board* board) {
   mainThread->nodes      = 0;
   mainThread->tbhits     = 0;
   mainThread->nmpMinPly  = 0;
+  mainThread->startDepth = 0;
 
   memcpy(&mainThread->board, board, offsetof(Board, accumulators));
 
@@ -223,10 +413,8 @@ void SetupMainThread(Board* board) {
     mainThread->numRootMoves = Limits.searchable.count;
   } else {
     SimpleMoveList ml[1];
-    TBRootMoves(ml, board);
-
-    if (!ml->count)
-      RootMoves(ml, board);
+    TBRootProbeStart(board);
+    RootMoves(ml, board);
 
     for (int i = 0; i < ml->count; i++)
       InitRootMove(&mainThread->rootMoves[i], ml->moves[i]);
@@ -244,14 +432,42 @@ void SetupOtherThreads(Board* board) {
     thread->nodes      = 0;
     thread->tbhits     = 0;
     thread->nmpMinPly  = 0;
+    thread->startDepth = mainThread->startDepth;
 
-    for (int j = 0; j < mainThread->numRootMoves; j++)
-      InitRootMove(&thread->rootMoves[j], mainThread->rootMoves[j].move);
+    // copied whole so helpers share a warm started root too
+    memcpy(thread->rootMoves, mainThread->rootMoves, mainThread->numRootMoves * sizeof(RootMove));
 
     thread->numRootMoves = mainThread->numRootMoves;
 
     memcpy(&thread->board, board, offsetof(Board, accumulators));
+
+    // Every thread is asleep until the search is started
+    if (SEED_HELPERS)
+      SeedHistory(thread, mainThread);
   }
+
+  for (int i = 0; i < Min(256, mainThread->numRootMoves); i++)
+    atomic_store_explicit(&Threads.splitMoves[i], mainThread->rootMoves[i].move, memory_order_relaxed);
+}
+
+// Sets a thread up to search board by itself, without StartSearch and the rest
+// of the pool (datagen)
+void SetupSingleThread(ThreadData* thread, Board* board) {
+  thread->calls      = Limits.hitrate;
+  thread->nodes      = 0;
+  thread->tbhits     = 0;
+  thread->nmpMinPly  = 0;
+  thread->startDepth = 0;
+
+  memcpy(&thread->board, board, offsetof(Board, accumulators));
+
+  SimpleMoveList ml[1];
+  RootMoves(ml, board);
+
+  for (int i = 0; i < ml->count; i++)
+    InitRootMove(&thread->rootMoves[i], ml->moves[i]);
+
+  thread->numRootMoves = ml->count;
 }
 
 // sum node counts
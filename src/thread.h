@@ -27,10 +27,21 @@ typedef struct {
   int count;
 
   pthread_mutex_t mutex, lock;
-  pthread_cond_t sleep;
+  pthread_cond_t sleep, wake, done; // wake: every idle thread blocks on it, see ThreadSleep
 
+  int pending; // actions started by ThreadsRun still running
   uint8_t init, searching, sleeping, stopOnPonderHit;
+  uint8_t spin; // idle threads spin before blocking, see ThreadSleep
   atomic_uchar ponder, stop;
+
+  // Microseconds spent getting searches going and winding them down (smpbench)
+  uint64_t startTime, setupTime, joinTime, voteTime;
+  atomic_uint_fast64_t wakeTime;  // summed over the helpers
+  atomic_uint_fast64_t lastWake;  // until the last helper of this search started
+  uint64_t allAwakeTime;          // lastWake summed over searches
+
+  // The main thread's MultiPV lines as of its last completed depth, see PullSplitLines
+  atomic_uint splitMoves[256];
 } ThreadPool;
 
 extern ThreadPool Threads;
@@ -38,16 +49,21 @@ extern ThreadPool Threads;
 void ThreadWaitUntilSleep(ThreadData* thread);
 void ThreadWait(ThreadData* thread, atomic_uchar* cond);
 void ThreadWake(ThreadData* thread, int action);
+void ThreadsWakeHelpers(int action);
 void ThreadIdle(ThreadData* thread);
+void ThreadsRun(int action);
+void ThreadsWait();
 void* ThreadInit(void* arg);
 void ThreadCreate(int i);
 void ThreadDestroy(ThreadData* thread);
 void ThreadsSetNumber(int n);
+void ThreadsSmallNetworkMemory();
 void ThreadsExit();
 void ThreadsInit();
 
 void SetupMainThread(Board* board);
 void SetupOtherThreads(Board* board);
+void SetupSingleThread(ThreadData* thread, Board* board);
 
 uint64_t NodesSearched();
 uint64_t TBHits();
@@ -0,0 +1,108 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "trace.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "thread.h"
+#include "util.h"
+
+int TRACING = 0;
+
+// Only ever written by its own thread, and only read while the pool sleeps
+void TraceRecord(ThreadData* thread, char ph, const char* name, int arg) {
+  TraceRing* ring = thread->trace;
+  if (!ring)
+    return;
+
+  TraceEvent* e = &ring->events[ring->head++ & (TRACE_RING_SIZE - 1)];
+  e->ts         = GetTimeUS();
+  e->name       = name;
+  e->arg        = arg;
+  e->ph         = ph;
+}
+
+void TraceAlloc(ThreadData* thread) {
+  if (thread->trace)
+    return;
+
+  thread->trace = calloc(1, sizeof(TraceRing));
+  if (thread->trace)
+    thread->trace->tid = thread->idx;
+}
+
+void TraceFree(ThreadData* thread) {
+  free(thread->trace);
+  thread->trace = NULL;
+}
+
+// Rings are allocated before recording starts and kept when it stops, so
+// whatever was captured can still be written out
+void TraceSet(int enabled) {
+  if (enabled)
+    for (int i = 0; i < Threads.count; i++)
+      TraceAlloc(Threads.threads[i]);
+
+  TRACING = enabled;
+}
+
+// Writes every ring as Chrome trace-event JSON (chrome://tracing, Perfetto)
+// and empties them
+int TraceWrite(const char* path) {
+  FILE* fp = fopen(path, "w");
+  if (!fp)
+    return 0;
+
+  fprintf(fp, "{\"traceEvents\":[\n");
+
+  int first = 1;
+  for (int i = 0; i < Threads.count; i++) {
+    TraceRing* ring = Threads.threads[i]->trace;
+    if (!ring)
+      continue;
+
+    fprintf(fp,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+            first ? "" : ",\n",
+            ring->tid,
+            ring->tid);
+    first = 0;
+
+    uint64_t start = ring->head > TRACE_RING_SIZE ? ring->head - TRACE_RING_SIZE : 0;
+    for (uint64_t j = start; j < ring->head; j++) {
+      TraceEvent* e = &ring->events[j & (TRACE_RING_SIZE - 1)];
+
+      fprintf(fp,
+              ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu64 ",\"pid\":1,\"tid\":%d",
+              e->name,
+              e->ph,
+              e->ts,
+              ring->tid);
+      if (e->ph == 'B')
+        fprintf(fp, ",\"args\":{\"value\":%d}", e->arg);
+      fprintf(fp, "}");
+    }
+
+    ring->head = 0;
+  }
+
+  fprintf(fp, "\n]}\n");
+  fclose(fp);
+  return 1;
+}
@@ -0,0 +1,61 @@
+// Berserk is a UCI compliant chess engine written in C
+// Copyright (C) 2024 Jay Honnold
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "types.h"
+
+// Events kept per thread, older ones are overwritten
+#define TRACE_RING_SIZE 65536
+
+typedef struct {
+  uint64_t ts;
+  const char* name;
+  int32_t arg;
+  char ph;
+} TraceEvent;
+
+typedef struct TraceRing {
+  uint64_t head;
+  int tid; // idx at creation, the pool swaps idx's after voting
+  TraceEvent events[TRACE_RING_SIZE];
+} TraceRing;
+
+extern int TRACING;
+
+// A single predictable branch when tracing is off
+#define TraceBegin(thread, name, arg)                                                                                  \
+  do {                                                                                                                 \
+    if (__builtin_expect(TRACING, 0))                                                                                  \
+      TraceRecord(thread, 'B', name, arg);                                                                             \
+  } while (0)
+
+#define TraceEnd(thread, name)                                                                                         \
+  do {                                                                                                                 \
+    if (__builtin_expect(TRACING, 0))                                                                                  \
+      TraceRecord(thread, 'E', name, 0);                                                                               \
+  } while (0)
+
+void TraceRecord(ThreadData* thread, char ph, const char* name, int arg);
+void TraceAlloc(ThreadData* thread);
+void TraceFree(ThreadData* thread);
+void TraceSet(int enabled);
+int TraceWrite(const char* path);
+
+#endif
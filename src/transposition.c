@@ -21,48 +21,73 @@
 #include <stdlib.h>
 #include <string.h>
 
-#if defined(__linux__)
+#if !defined(_WIN32)
+#include <fcntl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #include "bits.h"
+#include "numa.h"
+#include "random.h"
 #include "search.h"
 #include "thread.h"
 #include "transposition.h"
 #include "types.h"
+#include "util.h"
 
 const int DEPTH_OFFSET = -2;
 
 // Global TT
 TTTable TT = {0};
 
+// Saved tables start with a header padded to a page, so the buckets
+// that follow can be mapped straight from the file
+#define TT_FILE_MAGIC   "BRSKHASH"
+#define TT_FILE_VERSION 1
+#define TT_FILE_HEADER  4096
+
+typedef struct {
+  char magic[8];
+  uint32_t version, bucketBytes, bucketSize, keyBits;
+  uint64_t count;
+  uint8_t age;
+} TTFileHeader;
+
 size_t TTInit(int mb) {
   if (TT.mem)
     TTFree();
 
   uint64_t size = (uint64_t) mb * MEGABYTE;
 
-#if defined(__linux__)
-  const size_t alignment = 2 * MEGABYTE;
-#else
-  const size_t alignment = 4096;
-#endif
+  TT.mem  = LargePagesAlloc(size, &TT.pages);
+  TT.size = size;
 
-  TT.mem = AlignedMalloc(size, alignment);
-
-#if defined(MADV_HUGEPAGE)
-  madvise(TT.mem, size, MADV_HUGEPAGE);
-#endif
+  // Pages are placed when first touched (by the search threads probing them),
+  // so the interleave policy has to be applied before that
+  if (NUMA_HASH == NUMA_HASH_INTERLEAVE)
+    NumaInterleave(TT.mem, size);
 
+  // Fresh allocations are already zeroed (lazily, as pages are touched)
   TT.buckets = (TTBucket*) TT.mem;
   TT.count   = size / sizeof(TTBucket);
 
-  TTClear();
   return size;
 }
 
 void TTFree() {
-  AlignedFree(TT.mem);
+  // A clear may still be running in the background
+  ThreadsWait();
+
+#if !defined(_WIN32)
+  if (TT.pages == PAGES_FILE)
+    munmap(TT.mem, TT_FILE_HEADER + TT.size);
+  else
+#endif
+    LargePagesFree(TT.mem, TT.size, TT.pages);
+
+  TT.mem = NULL;
 }
 
 void TTClearPart(int idx) {
@@ -77,11 +102,10 @@ void TTClearPart(int idx) {
   memset(TT.buckets + begin / sizeof(TTBucket), 0, end - begin);
 }
 
+// Asynchronous, see ThreadsRun. The table is usable straight away: a search
+// started meanwhile has each thread join once it has cleared its part.
 inline void TTClear() {
-  for (int i = 0; i < Threads.count; i++)
-    ThreadWake(Threads.threads[i], THREAD_TT_CLEAR);
-  for (int i = 0; i < Threads.count; i++)
-    ThreadWaitUntilSleep(Threads.threads[i]);
+  ThreadsRun(THREAD_TT_CLEAR);
 }
 
 inline void TTUpdate() {
@@ -106,24 +130,35 @@ inline TTEntry* TTProbe(uint64_t hash,
                         int* ttBound,
                         int* pv) {
   TTEntry* const bucket    = TT.buckets[TTIdx(hash)].entries;
-  const uint16_t shortHash = (uint16_t) hash;
+  const TTKey_t shortHash = (TTKey_t) hash;
 
   for (int i = 0; i < BUCKET_SIZE; i++) {
-    if (bucket[i].hash == shortHash || !bucket[i].depth) {
+    // Validate a private copy so the fields returned are the ones checked
+    TTEntry entry = bucket[i];
+
+    if (TTKey(&entry) == shortHash || !entry.depth) {
       bucket[i].agePvBound = (uint8_t) (TT.age | (bucket[i].agePvBound & (PV_MASK | BOUND_MASK)));
-      *hit                 = !!bucket[i].depth;
+      *hit                 = !!entry.depth;
 
       if (*hit) {
-        *hashMove = TTMove(&bucket[i]);
-        *ttEval   = TTEval(&bucket[i]);
-        *ttScore  = TTScore(&bucket[i], ply);
-        *ttDepth  = TTDepth(&bucket[i]);
-        *ttBound  = TTBound(&bucket[i]);
-        *pv       = *pv || TTPV(&bucket[i]);
+        *hashMove = TTMove(&entry);
+        *ttEval   = TTEval(&entry);
+        *ttScore  = TTScore(&entry, ply);
+        *ttDepth  = TTDepth(&entry);
+        *ttBound  = TTBound(&entry);
+        *pv       = *pv || TTPV(&entry);
       }
 
       return &bucket[i];
     }
+
+#if defined(STATS)
+    // A mismatching entry that reads differently a second time raced a TTPut.
+    // Some of those were torn, this can't tell which
+    TTEntry again = bucket[i];
+    if (memcmp(&entry, &again, sizeof(TTEntry)))
+      IncRlx(TT.changed);
+#endif
   }
 
   *hit = 0;
@@ -139,23 +174,29 @@ inline TTEntry* TTProbe(uint64_t hash,
 
 inline void
 TTPut(TTEntry* tt, uint64_t hash, int depth, int16_t score, uint8_t bound, Move move, int ply, int16_t eval, int pv) {
-  uint16_t shortHash = (uint16_t) hash;
+  TTKey_t shortHash = (TTKey_t) hash;
 
   if (score >= TB_WIN_BOUND)
     score += ply;
   else if (score <= -TB_WIN_BOUND)
     score -= ply;
 
-  if (move || shortHash != tt->hash)
-    TTStoreMove(tt, move);
+  // Build the new entry privately and publish it with a single copy
+  TTEntry entry   = *tt;
+  const int match = TTKey(&entry) == shortHash;
+
+  if (move || !match)
+    TTStoreMove(&entry, move);
 
-  if ((bound == BOUND_EXACT) || shortHash != tt->hash || depth + 4 > TTDepth(tt)) {
-    tt->hash       = shortHash;
-    tt->score      = score;
-    tt->depth      = (uint8_t) (depth - DEPTH_OFFSET);
-    tt->agePvBound = (uint8_t) (TT.age | (pv << 2) | bound);
-    TTStoreEval(tt, eval);
+  if ((bound == BOUND_EXACT) || !match || depth + 4 > TTDepth(&entry)) {
+    entry.score      = score;
+    entry.depth      = (uint8_t) (depth - DEPTH_OFFSET);
+    entry.agePvBound = (uint8_t) (TT.age | (pv << 2) | bound);
+    TTStoreEval(&entry, eval);
   }
+
+  entry.hash = shortHash ^ TTChecksum(&entry);
+  *tt        = entry;
 }
 
 int TTFull() {
@@ -167,3 +208,138 @@ int TTFull() {
 
   return c / BUCKET_SIZE;
 }
+
+// Exact count of the entries written this search, a full scan of the table
+uint64_t TTStored() {
+  uint64_t c = 0;
+
+  for (uint64_t i = 0; i < TT.count; i++)
+    for (int j = 0; j < BUCKET_SIZE; j++)
+      c += TT.buckets[i].entries[j].depth && (TT.buckets[i].entries[j].agePvBound & AGE_MASK) == TT.age;
+
+  return c;
+}
+
+// Probe random keys, which are (almost surely) not in the table, counting
+// how often they would be reported as a hit for a position never stored
+double TTFalseHitRate(int samples) {
+  uint64_t hits = 0;
+
+  for (int i = 0; i < samples; i++) {
+    const uint64_t hash  = RandomUInt64();
+    TTEntry* const entry = TT.buckets[TTIdx(hash)].entries;
+
+    for (int j = 0; j < BUCKET_SIZE; j++)
+      hits += entry[j].depth && TTKey(&entry[j]) == (TTKey_t) hash;
+  }
+
+  return (double) hits / samples;
+}
+
+const char* TTLayout() {
+  static char layout[64];
+  sprintf(layout,
+          "%d x %d-bit keys in %d byte buckets",
+          BUCKET_SIZE,
+          (int) (8 * sizeof(TTKey_t)),
+          (int) sizeof(TTBucket));
+
+  return layout;
+}
+
+INLINE void TTFileHeaderInit(TTFileHeader* header) {
+  memset(header, 0, sizeof(TTFileHeader));
+  memcpy(header->magic, TT_FILE_MAGIC, sizeof(header->magic));
+
+  header->version     = TT_FILE_VERSION;
+  header->bucketBytes = sizeof(TTBucket);
+  header->bucketSize  = BUCKET_SIZE;
+  header->keyBits     = 8 * sizeof(TTKey_t);
+  header->count       = TT.count;
+  header->age         = TT.age;
+}
+
+int TTSave(const char* path) {
+  ThreadsWait();
+
+  FILE* fout = fopen(path, "wb");
+  if (!fout)
+    return 0;
+
+  char header[TT_FILE_HEADER] = {0};
+  TTFileHeaderInit((TTFileHeader*) header);
+
+  int success = fwrite(header, TT_FILE_HEADER, 1, fout) == 1 &&
+                fwrite(TT.buckets, sizeof(TTBucket), TT.count, fout) == TT.count;
+
+  return !fclose(fout) && success;
+}
+
+// Replace the table with one saved by TTSave. Where possible the file is
+// mapped privately as the new backing store, so the table is usable at once
+// and pages are read in as the search touches them (writes never reach the
+// file). The saved geometry has to match the one this binary was built with.
+int TTLoad(const char* path) {
+  TTFileHeader expected, header;
+  TTFileHeaderInit(&expected);
+
+  FILE* fin = fopen(path, "rb");
+  if (!fin)
+    return 0;
+
+  int valid = fread(&header, sizeof(TTFileHeader), 1, fin) == 1 &&
+              !memcmp(header.magic, expected.magic, sizeof(header.magic)) && header.version == expected.version &&
+              header.bucketBytes == expected.bucketBytes && header.bucketSize == expected.bucketSize &&
+              header.keyBits == expected.keyBits && header.count;
+  fclose(fin);
+
+  if (!valid)
+    return 0;
+
+  const uint64_t size = header.count * sizeof(TTBucket);
+
+#if !defined(_WIN32)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat st;
+  void* mem = MAP_FAILED;
+  if (!fstat(fd, &st) && (uint64_t) st.st_size >= TT_FILE_HEADER + size)
+    mem = mmap(NULL, TT_FILE_HEADER + size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mem == MAP_FAILED)
+    return 0;
+
+#if defined(MADV_WILLNEED)
+  madvise(mem, TT_FILE_HEADER + size, MADV_WILLNEED);
+#endif
+
+  TTFree();
+
+  TT.mem     = mem;
+  TT.buckets = (TTBucket*) ((char*) mem + TT_FILE_HEADER);
+  TT.pages   = PAGES_FILE;
+#else
+  fin = fopen(path, "rb");
+  if (!fin)
+    return 0;
+
+  TTFree();
+
+  TT.mem     = LargePagesAlloc(size, &TT.pages);
+  TT.buckets = (TTBucket*) TT.mem;
+
+  fseek(fin, TT_FILE_HEADER, SEEK_SET);
+  if (fread(TT.buckets, sizeof(TTBucket), header.count, fin) != header.count)
+    memset(TT.buckets, 0, size);
+  fclose(fin);
+#endif
+
+  TT.size  = size;
+  TT.count = header.count;
+  TT.age   = header.age;
+
+  return 1;
+}
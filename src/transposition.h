@@ -20,9 +20,22 @@
 #include "types.h"
 #include "util.h"
 
-#define NO_ENTRY    0ULL
-#define MEGABYTE    (1024ull * 1024ull)
-#define BUCKET_SIZE 3
+#define NO_ENTRY 0ULL
+#define MEGABYTE (1024ull * 1024ull)
+
+// Bucket geometry is chosen at compile time (make TT_LAYOUT=wide).
+// The default packs 3 entries with 16-bit keys into half a cache line, the
+// wide layout packs 5 entries with 32-bit keys into a full cache line which
+// cuts the false hit rate of huge tables by several orders of magnitude.
+#if defined(TT_WIDE)
+#define BUCKET_SIZE  5
+#define BUCKET_BYTES 64
+typedef uint32_t TTKey_t;
+#else
+#define BUCKET_SIZE  3
+#define BUCKET_BYTES 32
+typedef uint16_t TTKey_t;
+#endif
 
 #define BOUND_MASK (0x3)
 #define PV_MASK    (0x4)
@@ -31,7 +44,7 @@
 #define AGE_CYCLE  (255 + AGE_INC)
 
 typedef struct __attribute__((packed)) {
-  uint16_t hash;
+  TTKey_t hash;
   uint8_t depth;
   uint8_t agePvBound;
   uint32_t evalAndMove;
@@ -40,14 +53,18 @@ typedef struct __attribute__((packed)) {
 
 typedef struct {
   TTEntry entries[BUCKET_SIZE];
-  uint16_t padding;
+  uint8_t padding[BUCKET_BYTES - BUCKET_SIZE * sizeof(TTEntry)];
 } TTBucket;
 
+_Static_assert(sizeof(TTBucket) == BUCKET_BYTES, "TTBucket must fill its bucket exactly");
+
 typedef struct {
   void* mem;
   TTBucket* buckets;
-  uint64_t count;
+  uint64_t count, size;
+  int pages;
   uint8_t age;
+  atomic_uint_fast64_t changed; // STATS builds only, see TTProbe
 } TTTable;
 
 enum {
@@ -84,9 +101,30 @@ void TTPut(TTEntry* tt,
            int16_t eval,
            int pv);
 int TTFull();
+uint64_t TTStored();
+double TTFalseHitRate(int samples);
+int TTSave(const char* path);
+int TTLoad(const char* path);
+const char* TTLayout();
 
+#define HASH_DEFAULT 16
 #define HASH_MAX ((int) (pow(2, 32) * sizeof(TTBucket) / MEGABYTE))
 
+// Entries are read and written without locks, so a concurrent TTPut can leave
+// a reader with a mix of two entries. The stored hash is xor'd with a fold of
+// the entry's data (excluding the age, which probes refresh in place) so that
+// a torn entry no longer matches the position it claims to be for.
+INLINE TTKey_t TTChecksum(TTEntry* e) {
+  const uint32_t data = ((uint32_t) (uint16_t) e->score << 16) | (e->depth << 8) | (e->agePvBound & (PV_MASK | BOUND_MASK));
+  const uint32_t fold = e->evalAndMove ^ data;
+
+  return (TTKey_t) (sizeof(TTKey_t) == sizeof(uint16_t) ? fold ^ (fold >> 16) : fold);
+}
+
+INLINE TTKey_t TTKey(TTEntry* e) {
+  return e->hash ^ TTChecksum(e);
+}
+
 INLINE Move TTMove(TTEntry* e) {
   // Lower 20 bits for move
   return (e->evalAndMove & 0xfffff);
@@ -20,7 +20,6 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <pthread.h>
-#include <setjmp.h>
 #include <stdatomic.h>
 
 #define MAX_SEARCH_PLY 201 // effective max depth 250
@@ -28,12 +27,14 @@
 
 #define N_KING_BUCKETS 16
 
-#define N_FEATURES (N_KING_BUCKETS * 12 * 64)
-#define N_HIDDEN   1024
-#define N_L1       (2 * N_HIDDEN)
-#define N_L2       16
-#define N_L3       32
-#define N_OUTPUT   1
+// The hidden size is read from the network at runtime, see SPECIALIZE_HIDDEN
+#define N_FEATURES       (N_KING_BUCKETS * 12 * 64)
+#define N_HIDDEN_DEFAULT 1024
+#define N_HIDDEN_MAX     1536
+#define N_L1_MAX         (2 * N_HIDDEN_MAX)
+#define N_L2             16
+#define N_L3             32
+#define N_OUTPUT         1
 
 #define ALIGN_ON 64
 #define ALIGN    __attribute__((aligned(ALIGN_ON)))
@@ -42,6 +43,9 @@
 #define PAWN_CORRECTION_SIZE  131072
 #define PAWN_CORRECTION_MASK  (PAWN_CORRECTION_SIZE - 1)
 
+#define EVAL_CACHE_SIZE 16384
+#define EVAL_CACHE_MASK (EVAL_CACHE_SIZE - 1)
+
 typedef int Score;
 typedef uint64_t BitBoard;
 typedef uint32_t Move;
@@ -57,44 +61,76 @@ typedef struct {
   uint8_t correct[2];
   uint16_t captured;
   Move move;
-  acc_t values[2][N_HIDDEN] ALIGN;
+  acc_t values[2][N_HIDDEN_MAX] ALIGN;
 } Accumulator;
 
 typedef struct {
-  acc_t values[N_HIDDEN] ALIGN;
+  acc_t values[N_HIDDEN_MAX] ALIGN;
   BitBoard pcs[12];
 } AccumulatorKingState;
 
+// With NN_INT8 the input weights are stored as int8 with an int16 scale per
+// hidden neuron, halving the memory traffic of accumulator updates
+#if defined(NN_INT8)
+typedef int8_t weight_t;
+#else
+typedef int16_t weight_t;
+#endif
+
+typedef struct {
+  size_t hidden; // 0 when nothing is loaded
+
+  // Either our own (huge page) copy, or a read-only mapping of an exported network
+  weight_t* inputWeights;
+  void* mem;
+  size_t memSize;
+  int memPages;
+
+  int16_t inputBiases[N_HIDDEN_MAX] ALIGN;
+#if defined(NN_INT8)
+  int16_t inputScales[N_HIDDEN_MAX] ALIGN;
+#endif
+
+  int8_t l1Weights[N_L1_MAX * N_L2] ALIGN;
+  int32_t l1Biases[N_L2] ALIGN;
+
+  float l2Weights[N_L2 * N_L3] ALIGN;
+  float l2Biases[N_L3] ALIGN;
+
+  float outputWeights[N_L3 * N_OUTPUT] ALIGN;
+  float outputBias;
+} Network;
+
 typedef struct {
-  int castling;
-  int ep;
-  int fmr;
-  int nullply;
-  uint64_t zobrist;
+  uint8_t castling;
+  uint8_t ep;
+  uint8_t threatsReady;
+  int16_t fmr;
+  int16_t nullply;
   uint64_t pawnZobrist;
   BitBoard checkers;
   BitBoard pinned;
   BitBoard threatened;
-  BitBoard threatenedBy[6];
+  BitBoard threatenedBy[4];
   int capture;
 } BoardHistory;
 
 typedef struct {
   // The below are in order of BoardHistory above for copies
-  int castling; // castling mask e.g. 1111 = KQkq, 1001 = Kq
-  int epSquare; // en passant square (a8 or 0 is not valid so that marks no
-                // active ep)
-  int fmr;      // half move count for 50 move rule
-  int nullply;  // distance from last nullmove
+  uint8_t castling;     // castling mask e.g. 1111 = KQkq, 1001 = Kq
+  uint8_t epSquare;     // en passant square (a8 or 0 is not valid so that marks no
+                        // active ep)
+  uint8_t threatsReady; // threatened(By) are up to date, see Threatened()
+  int16_t fmr;          // half move count for 50 move rule
+  int16_t nullply;      // distance from last nullmove
 
-  uint64_t zobrist;     // zobrist hash of the position
   uint64_t pawnZobrist; // pawn zobrist hash of the position (pawns + stm)
 
   BitBoard checkers; // checking piece squares
   BitBoard pinned;   // pinned pieces
 
-  BitBoard threatened;  // opponent "threatening" these squares
-  BitBoard threatenedBy[6];
+  BitBoard threatened;      // opponent "threatening" these squares, see Threatened()
+  BitBoard threatenedBy[4]; // pawn to rook only, the queen and king are only in threatened
 
   int stm;     // side to move
   int xstm;    // not side to move
@@ -102,6 +138,7 @@ typedef struct {
   int moveNo;  // game move number
   int phase;   // efficiently updated phase for scaling
 
+  uint64_t zobrist;      // zobrist hash of the position, saved to keys
   uint64_t piecesCounts; // "material key" - pieces left on the board
 
   int squares[64];         // piece per square
@@ -111,10 +148,16 @@ typedef struct {
   int cr[4];
   int castlingRights[64];
 
+  // zobrist of each history entry, apart from it so repetition scans are dense
+  uint64_t keys[MAX_SEARCH_PLY + 100];
   BoardHistory history[MAX_SEARCH_PLY + 100];
 
   Accumulator* accumulators;
   AccumulatorKingState* refreshTable;
+
+  // Stack and refresh table of the small network, see Evaluate
+  Accumulator* smallAccumulators;
+  AccumulatorKingState* smallRefreshTable;
 } Board;
 
 typedef struct {
@@ -128,7 +171,23 @@ typedef struct {
   Move moves[MAX_SEARCH_PLY];
 } PV;
 
-typedef int16_t PieceTo[12][64];
+// Continuation history piece indexing, a row belongs to an earlier move and
+// is indexed by the piece of a move that follows it plies later.
+// make CH_LAYOUT=compact indexes rows by piece type alone, so both colors share
+// them, and keeps one color bit for the following piece: whether it is the
+// row mover's (even plies) or its opponent's (odd). Half the footprint.
+#define CH_PIECES 12
+#if defined(CH_COMPACT)
+#define CH_ROWS                6
+#define CHRow(pc)              ((pc) >> 1)
+#define CHPiece(pc, plies)     (((pc) & ~1) | ((plies) & 1))
+#else
+#define CH_ROWS                12
+#define CHRow(pc)              (pc)
+#define CHPiece(pc, plies)     (pc)
+#endif
+
+typedef int16_t PieceTo[CH_PIECES][64];
 
 typedef struct {
   int ply, staticEval, de;
@@ -137,14 +196,22 @@ typedef struct {
   Move killers[2];
 } SearchStack;
 
+typedef struct ThreadData ThreadData;
+
 typedef struct {
   long start;
-  int alloc;
-  int max;
+  int64_t alloc;
+  int64_t max;
 
   uint64_t nodes;
   int hitrate;
 
+  // With nodestime alloc and max are in nodes, the clock of the game is kept
+  // here in nodes too and charged with what every search used
+  int nodesTime;
+  int64_t inc;
+  int64_t nodesLeft;
+
   int timeset;
   int depth;
   int mate;
@@ -154,7 +221,12 @@ typedef struct {
   int multiPV;
   int infinite;
   int searchMoves;
+  int quiet;       // no info or bestmove output, for machine readable benches
+  int independent; // every thread searches a root of its own, none of them helps thread 0 (datagen)
   SimpleMoveList searchable;
+
+  // Replaces the info (no bestMove) and bestmove output when set, see libberserk.c
+  void (*report)(ThreadData* thread, Board* board, int alpha, int beta, Move bestMove, Move ponderMove);
 } SearchParams;
 
 typedef struct {
@@ -165,25 +237,66 @@ typedef struct {
   PV pv;
 } RootMove;
 
+// Debug counters, only incremented in STATS builds (see stats.h)
+typedef struct {
+  uint64_t ttProbes, ttHits, ttCutoffs;
+  uint64_t hashMoves, hashMovesIllegal;
+  uint64_t nnLazyUpdates, nnLazyPlies;
+  uint64_t nnRefreshes, nnRefreshFeatures;
+  uint64_t evalCacheProbes, evalCacheHits;
+  uint64_t nnSmallEvals;
+  uint64_t mpScored, mpPicked, mpQuietGathers, mpQuietLines;
+  uint64_t mpPickers, mpNoisy, mpKillers, mpQuiets, mpBadNoisy;
+  uint64_t mpProbcut, mpQsNoisy, mpQsChecks, mpEvasions, mpEvasionQuiets;
+  uint64_t tbProbes, tbCacheProbes, tbCacheHits;
+  uint64_t cycleChecks, cycleHits;
+  uint64_t nmpTries, nmpCutoffs, nmpVerifies;
+  uint64_t lmrSearches, lmrResearches;
+  uint64_t pcTries, pcCutoffs;
+} Stats;
+
+// Raw network output, verified by the upper half of the zobrist
+typedef struct {
+  uint32_t key;
+  int32_t score;
+} EvalCacheEntry;
+
 enum {
   THREAD_SLEEP,
   THREAD_SEARCH,
   THREAD_TT_CLEAR,
   THREAD_SEARCH_CLEAR,
+  THREAD_PERFT,
+  THREAD_DATAGEN,
   THREAD_EXIT,
   THREAD_RESUME
 };
 
-typedef struct ThreadData ThreadData;
-
 struct ThreadData {
-  int idx, multiPV, depth, seldepth;
-  atomic_uint_fast64_t nodes, tbhits;
+  // Written on every node by this thread alone, so they get a cache line of
+  // their own and other threads reading idx or depth don't bounce it
+  _Alignas(64) atomic_uint_fast64_t nodes;
+  atomic_uint_fast64_t tbhits;
+  uint64_t nodeLimit; // stops this thread alone when set, see datagen.c
+
+  _Alignas(64) int idx;
+  int multiPV, depth, seldepth, completedDepth;
+  int startDepth; // iterations skipped, see WarmStartRoot
 
   int nmpMinPly, npmColor;
 
   Accumulator* accumulators;
   AccumulatorKingState* refreshTable;
+  Accumulator* smallAccumulators;
+  AccumulatorKingState* smallRefreshTable;
+
+  void* nnMem; // single allocation backing the accumulators and refresh tables
+  uint64_t nnMemSize;
+  int nnMemPages;
+
+  // Same size, for the small network's and only while one is loaded
+  void* smallNnMem;
+  int smallNnMemPages;
 
   Board board;
 
@@ -194,16 +307,21 @@ struct ThreadData {
 
   Move counters[12][64];         // counter move butterfly table
   int16_t hh[2][2][2][64 * 64];  // history heuristic butterfly table (stm / threatened)
-  int16_t ch[2][12][64][12][64]; // continuation move history table
+  int16_t ch[2][CH_ROWS][64][CH_PIECES][64]; // continuation move history table
   int16_t caph[12][64][2][7];    // capture history (piece - to - defeneded - captured_type)
 
   int16_t pawnCorrection[PAWN_CORRECTION_SIZE];
 
+  EvalCacheEntry evalCache[EVAL_CACHE_SIZE];
+
+  Stats stats;
+  struct TraceRing* trace; // allocated when tracing is enabled, see trace.h
+
   int action, calls;
+  int stopped; // set once this thread's search has to unwind
   pthread_t nativeThread;
   pthread_mutex_t mutex;
   pthread_cond_t sleep;
-  jmp_buf exit;
 };
 
 typedef struct {
@@ -255,7 +373,7 @@ typedef struct {
   ThreadData* thread;
   SearchStack* ss;
   Move hashMove, killer1, killer2, counter;
-  int seeCutoff, phase, genChecks;
+  int seeCutoff, phase, genChecks, depth;
 
   ScoredMove *current, *end, *endBad;
   ScoredMove moves[MAX_MOVES];
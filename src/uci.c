@@ -16,6 +16,7 @@
 
 #include "uci.h"
 
+#include <ctype.h>
 #include <limits.h>
 #include <math.h>
 #include <pthread.h>
@@ -25,23 +26,56 @@
 
 #include "bench.h"
 #include "board.h"
+#include "datagen.h"
 #include "eval.h"
+#include "history.h"
 #include "move.h"
 #include "movegen.h"
 #include "movepick.h"
 #include "nn/accumulator.h"
 #include "nn/evaluate.h"
+#include "numa.h"
 #include "perft.h"
 #include "pyrrhic/tbprobe.h"
 #include "search.h"
 #include "see.h"
+#include "server.h"
+#include "stats.h"
+#include "tb.h"
 #include "thread.h"
+#include "trace.h"
 #include "transposition.h"
 #include "util.h"
 
-#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+// The instruction sets this build (or, in a fat binary, the chosen copy) uses
+#if defined(__AVX512VNNI__)
+#define SIMD_NAME "avx512vnni"
+#elif defined(__AVX512F__) && defined(__AVX512BW__)
+#define SIMD_NAME "avx512"
+#elif defined(__AVXVNNI__)
+#define SIMD_NAME "avxvnni"
+#elif defined(__AVX2__)
+#define SIMD_NAME "avx2"
+#elif defined(__SSSE3__)
+#define SIMD_NAME "ssse3"
+#elif defined(__SSE2__)
+#define SIMD_NAME "sse2"
+#elif defined(__ARM_FEATURE_DOTPROD)
+#define SIMD_NAME "neon-dotprod"
+#elif defined(__ARM_NEON)
+#define SIMD_NAME "neon"
+#else
+#define SIMD_NAME "generic"
+#endif
+
+#if defined(USE_PEXT)
+#define BUILD_NAME SIMD_NAME "-pext"
+#else
+#define BUILD_NAME SIMD_NAME
+#endif
 
 int MOVE_OVERHEAD  = 50;
+int NODES_TIME     = 0; // nodes per millisecond the clock is played in, 0 for real time
 int MULTI_PV       = 1;
 int PONDER_ENABLED = 0;
 int CHESS_960      = 0;
@@ -84,25 +118,15 @@ void RootMoves(SimpleMoveList* moves, Board* board) {
 void ParseGo(char* in, Board* board) {
   in += 3;
 
-  Limits.depth            = MAX_SEARCH_PLY;
-  Limits.start            = GetTimeMS();
-  Limits.timeset          = 0;
-  Limits.stopped          = 0;
-  Limits.quit             = 0;
-  Limits.multiPV          = MULTI_PV;
-  Limits.searchMoves      = 0;
-  Limits.searchable.count = 0;
-  Limits.infinite         = 0;
-  Limits.mate             = 0;
-
   char* ptrChar = in;
-  int perft = 0, movesToGo = -1, moveTime = -1, time = -1, inc = 0, depth = -1, nodes = 0, ponder = 0, mate = 0;
+  int perft = 0, movesToGo = -1, moveTime = -1, time = -1, inc = 0, depth = -1, nodes = 0, ponder = 0, mate = 0,
+      infinite = 0;
 
   SimpleMoveList rootMoves;
   RootMoves(&rootMoves, board);
 
   if ((ptrChar = strstr(in, "infinite")))
-    Limits.infinite = 1;
+    infinite = 1;
 
   if ((ptrChar = strstr(in, "perft")))
     perft = atoi(ptrChar + 6);
@@ -143,6 +167,12 @@ void ParseGo(char* in, Board* board) {
     }
   }
 
+  // The clock is set up below
+  SetSearchLimits(depth, nodes, 0, MULTI_PV);
+  Limits.mate     = mate;
+  Limits.infinite = infinite;
+  Limits.quiet    = 0;
+
   if ((ptrChar = strstr(in, "searchmoves"))) {
     Limits.searchMoves = 1;
 
@@ -157,34 +187,42 @@ void ParseGo(char* in, Board* board) {
     return;
   }
 
-  Limits.depth = depth;
-  Limits.mate  = mate;
-  Limits.nodes = nodes;
+  // With nodestime every millisecond below is NODES_TIME nodes, and the
+  // remaining time is our own node clock rather than the gui's
+  int64_t unit = 1, myTime = time, myInc = inc, overhead = MOVE_OVERHEAD;
+  if (NODES_TIME && (moveTime != -1 || time != -1)) {
+    Limits.nodesTime = 1;
+    unit             = NODES_TIME;
+    myInc            = unit * inc;
+    overhead         = unit * MOVE_OVERHEAD;
 
-  if (Limits.nodes)
-    Limits.hitrate = Min(1000, Max(1, Limits.nodes / 100));
-  else
-    Limits.hitrate = 1000;
+    if (time != -1) {
+      if (!Limits.nodesLeft)
+        Limits.nodesLeft = unit * time;
+      myTime = Limits.nodesLeft;
+    }
+  }
+  Limits.inc = myInc;
 
   // "movetime" is essentially making a move with 1 to go for TC
   if (moveTime != -1) {
     Limits.timeset = 1;
-    Limits.alloc   = INT32_MAX;
-    Limits.max     = moveTime;
+    Limits.alloc   = INT64_MAX;
+    Limits.max     = unit * moveTime;
   } else {
     if (time != -1) {
       Limits.timeset = 1;
 
       if (movesToGo == -1) {
-        int total = Max(1, time + 50 * inc - 50 * MOVE_OVERHEAD);
+        int64_t total = Max(1, myTime + 50 * myInc - 50 * overhead);
 
-        Limits.alloc = Min(time * 0.4193, total * 0.0575);
-        Limits.max   = Min(time * 0.9221 - MOVE_OVERHEAD, Limits.alloc * 5.9280) - 10;
+        Limits.alloc = Min(myTime * 0.4193, total * 0.0575);
+        Limits.max   = Min(myTime * 0.9221 - overhead, Limits.alloc * 5.9280) - 10 * unit;
       } else {
-        int total = Max(1, time + movesToGo * inc - MOVE_OVERHEAD);
+        int64_t total = Max(1, myTime + movesToGo * myInc - overhead);
 
-        Limits.alloc = Min(time * 0.9, (0.9 * total) / Max(1, movesToGo / 2.5));
-        Limits.max   = Min(time * 0.8 - MOVE_OVERHEAD, Limits.alloc * 5.5) - 10;
+        Limits.alloc = Min(myTime * 0.9, (0.9 * total) / Max(1, movesToGo / 2.5));
+        Limits.max   = Min(myTime * 0.8 - overhead, Limits.alloc * 5.5) - 10 * unit;
       }
     } else {
       // no time control
@@ -195,21 +233,19 @@ void ParseGo(char* in, Board* board) {
 
   Limits.multiPV = Min(Limits.multiPV, Limits.searchMoves ? Limits.searchable.count : rootMoves.count);
   if (rootMoves.count == 1 && Limits.timeset)
-    Limits.max = Min(250, Limits.max);
-
-  if (depth <= 0)
-    Limits.depth = MAX_SEARCH_PLY - 1;
+    Limits.max = Min(250 * unit, Limits.max);
 
   printf(
-    "info string time %d start %ld alloc %d max %d depth %d timeset %d "
-    "searchmoves %d\n",
+    "info string time %d start %ld alloc %" PRId64 " max %" PRId64 " depth %d timeset %d "
+    "searchmoves %d%s\n",
     time,
     Limits.start,
     Limits.alloc,
     Limits.max,
     Limits.depth,
     Limits.timeset,
-    Limits.searchable.count);
+    Limits.searchable.count,
+    Limits.nodesTime ? " (nodes)" : "");
 
   StartSearch(board, ponder);
 }
@@ -250,22 +286,93 @@ void ParsePosition(char* in, Board* board) {
   }
 }
 
+int STARTUP_PROFILE = 0;
+
+void PrintStartupPhase(const char* name, uint64_t start) {
+  if (STARTUP_PROFILE)
+    printf("info string startup %-12s %8" PRIu64 " us\n", name, GetTimeUS() - start);
+}
+
+// The network copy and the hash allocation are the slow part of startup.
+// They are deferred to the first command that may need them, so the UCI
+// handshake and any setoption before it are answered straight away and an
+// EvalFile or Hash set in the meantime replaces, rather than follows, them.
+void FinishStartup() {
+  if (!NETWORK.hidden)
+    StartupPhase("network", LoadDefaultNN());
+
+  if (!TT.mem)
+    StartupPhase("hash", TTInit(HASH_DEFAULT));
+}
+
+// The handshake and options never touch the network or the hash
+INLINE int NeedsStartup(const char* in) {
+  if (!strncmp(in, "ucinewgame", 10))
+    return 1;
+
+  // The server gives each session its own hash, see ServerLoop
+  return strncmp(in, "uci", 3) && strncmp(in, "setoption", 9) && strncmp(in, "quit", 4) && strncmp(in, "stop", 4) &&
+         strncmp(in, "server", 6);
+}
+
 void PrintUCIOptions() {
-  printf("id name Berserk " VERSION "\n");
+  printf("id name Berserk " VERSION " (" BUILD_NAME ")\n");
   printf("id author Jay Honnold\n");
-  printf("option name Hash type spin default 16 min 2 max %d\n", HASH_MAX);
+  printf("option name Hash type spin default %d min 2 max %d\n", HASH_DEFAULT, HASH_MAX);
   printf("option name Threads type spin default 1 min 1 max 256\n");
+  printf("option name LargePages type check default false\n");
+  printf("option name NumaBind type check default false\n");
+  printf("option name NumaHash type combo default firsttouch var firsttouch var interleave\n");
+  printf("option name HelperPolicy type combo default none var none var skip var window\n");
+  printf("option name ABDADA type check default false\n");
+  printf("option name WarmStart type check default false\n");
+  printf("option name SharedCorrection type check default false\n");
+  printf("option name SeedHelpers type check default false\n");
+  printf("option name MultiPVSplit type check default false\n");
+  printf("option name PartialSort type check default false\n");
+  printf("option name PerftHash type spin default 0 min 0 max 65536\n");
+  printf("option name Trace type check default false\n");
   printf("option name SyzygyPath type string default <empty>\n");
+  printf("option name SyzygyProbeDepth type spin default 1 min 1 max 100\n");
+  printf("option name SyzygyProbeLimit type spin default 7 min 0 max 7\n");
+  printf("option name SyzygyPreload type spin default 0 min 0 max 7\n");
+  printf("option name SyzygyLock type check default false\n");
   printf("option name MultiPV type spin default 1 min 1 max 256\n");
   printf("option name Ponder type check default false\n");
   printf("option name UCI_ShowWDL type check default true\n");
   printf("option name UCI_Chess960 type check default false\n");
   printf("option name MoveOverhead type spin default 50 min 0 max 10000\n");
+  printf("option name NodesTime type spin default 0 min 0 max 10000\n");
   printf("option name Contempt type spin default 0 min -100 max 100\n");
   printf("option name EvalFile type string default <empty>\n");
+  printf("option name SmallEvalFile type string default <empty>\n");
   printf("uciok\n");
 }
 
+// Stop the running search, waking it up when it is waiting on a ponderhit or stop
+void StopSearch() {
+  if (!Threads.searching)
+    return;
+
+  Threads.stop = 1;
+  pthread_mutex_lock(&Threads.lock);
+  if (Threads.sleeping)
+    ThreadWake(Threads.threads[0], THREAD_RESUME);
+  Threads.sleeping = 0;
+  pthread_mutex_unlock(&Threads.lock);
+}
+
+// For commands that need the threads idle. A search that would never end on
+// its own (infinite, ponder) is stopped, any other is waited for
+void WaitForSearch() {
+  if (!Threads.searching)
+    return;
+
+  if (Limits.infinite || Threads.ponder)
+    StopSearch();
+  ThreadWaitUntilSleep(Threads.threads[0]);
+}
+
 int ReadLine(char* in) {
   if (fgets(in, 8192, stdin) == NULL)
     return 0;
@@ -291,34 +398,25 @@ void UCILoop() {
     if (in[0] == '\n')
       continue;
 
+    if (NeedsStartup(in))
+      FinishStartup();
+
     if (!strncmp(in, "isready", 7)) {
+      TBWaitForInit();
       printf("readyok\n");
     } else if (!strncmp(in, "position", 8)) {
       ParsePosition(in, &board);
     } else if (!strncmp(in, "ucinewgame", 10)) {
+      Limits.nodesLeft = 0;
       ParsePosition("position startpos\n", &board);
-      TTClear();
       SearchClear();
+      TTClear();
     } else if (!strncmp(in, "go", 2)) {
       ParseGo(in, &board);
     } else if (!strncmp(in, "stop", 4)) {
-      if (Threads.searching) {
-        Threads.stop = 1;
-        pthread_mutex_lock(&Threads.lock);
-        if (Threads.sleeping)
-          ThreadWake(Threads.threads[0], THREAD_RESUME);
-        Threads.sleeping = 0;
-        pthread_mutex_unlock(&Threads.lock);
-      }
+      StopSearch();
     } else if (!strncmp(in, "quit", 4)) {
-      if (Threads.searching) {
-        Threads.stop = 1;
-        pthread_mutex_lock(&Threads.lock);
-        if (Threads.sleeping)
-          ThreadWake(Threads.threads[0], THREAD_RESUME);
-        Threads.sleeping = 0;
-        pthread_mutex_unlock(&Threads.lock);
-      }
+      StopSearch();
       break;
     } else if (!strncmp(in, "uci", 3)) {
       PrintUCIOptions();
@@ -347,14 +445,97 @@ void UCILoop() {
       ParseFen(fen, &board);
 
       PerftTest(depth, &board);
-    } else if (!strncmp(in, "bench", 5)) {
+    } else if (!strncmp(in, "smpbench", 8)) {
+      strtok(in, " ");
+      char* d = strtok(NULL, " ") ?: "11";
+
+      // "smpbench nodes <n> [threads]" searches a node budget instead of a depth
+      uint64_t nodes = 0;
+      if (!strncmp(d, "nodes", 5)) {
+        char* n = strtok(NULL, " ");
+        nodes   = Max(1, n ? strtoull(n, NULL, 10) : 1000000);
+      }
+
+      char* t = strtok(NULL, " ");
+
+      SMPBench(atoi(d), nodes, Max(1, Min(256, t ? atoi(t) : Threads.count)));
+    } else if (!strncmp(in, "histbench", 9)) {
       strtok(in, " ");
       char* d = strtok(NULL, " ") ?: "13";
 
-      int depth = atoi(d);
-      Bench(depth);
+      HistoryBench(atoi(d));
+    } else if (!strncmp(in, "movepickbench", 13)) {
+      strtok(in, " ");
+      char* d = strtok(NULL, " ") ?: "13";
+
+      MovePickBench(atoi(d));
+    } else if (!strncmp(in, "movegenbench", 12)) {
+      strtok(in, " ");
+      char* n = strtok(NULL, " ") ?: "20000";
+
+      MoveGenBench(Max(1, atoi(n)));
+    } else if (!strncmp(in, "seebench", 8)) {
+      strtok(in, " ");
+      char* n = strtok(NULL, " ") ?: "100000";
+
+      SEEBench(Max(1, atoi(n)));
+    } else if (!strncmp(in, "ttbench", 7)) {
+      strtok(in, " ");
+      char* d = strtok(NULL, " ") ?: "13";
+
+      TTBench(atoi(d));
+    } else if (!strncmp(in, "bench", 5)) {
+      char* args = in + 5 + strspn(in + 5, " \n");
+
+      // "bench [depth]" is the classic text bench, anything else is a suite
+      if (!*args || isdigit(*args))
+        Bench(*args ? atoi(args) : 13);
+      else
+        BenchSuite(args);
+    } else if (!strncmp(in, "datagen ", 8)) {
+      Datagen(in + 8);
+    } else if (!strncmp(in, "analyze ", 8)) {
+      Analyze(in + 8);
+    } else if (!strncmp(in, "evalbatch ", 10)) {
+      EvalBatch(in + 10);
+    } else if (!strncmp(in, "exportnet ", 10)) {
+      if (ExportNetwork(in + 10))
+        printf("info string Exported network to %s\n", in + 10);
+      else
+        printf("info string Unable to export network to %s\n", in + 10);
+    } else if (!strncmp(in, "savehash ", 9)) {
+      WaitForSearch();
+
+      if (TTSave(in + 9))
+        printf("info string Saved hash to %s\n", in + 9);
+      else
+        printf("info string Unable to save hash to %s\n", in + 9);
+    } else if (!strncmp(in, "loadhash ", 9)) {
+      WaitForSearch();
+
+      if (TTLoad(in + 9))
+        printf("info string Loaded hash from %s (%" PRIu64 " MB) using %s\n",
+               in + 9,
+               (uint64_t) (TT.size / MEGABYTE),
+               PagesName(TT.pages));
+      else
+        printf("info string Unable to load hash from %s\n", in + 9);
+    } else if (!strncmp(in, "server", 6)) {
+      ServerLoop();
+      break;
+    } else if (!strncmp(in, "trace ", 6)) {
+      WaitForSearch();
+
+      if (TraceWrite(in + 6))
+        printf("info string Saved trace to %s\n", in + 6);
+      else
+        printf("info string Unable to save trace to %s\n", in + 6);
+    } else if (!strncmp(in, "stats clear", 11)) {
+      StatsClear();
+    } else if (!strncmp(in, "stats", 5)) {
+      StatsPrint();
     } else if (!strncmp(in, "threats", 7)) {
-      PrintBB(board.threatened);
+      PrintBB(Threatened(&board));
     } else if (!strncmp(in, "eval", 4)) {
       EvaluateTrace(&board);
     } else if (!strncmp(in, "see ", 4)) {
@@ -375,20 +556,127 @@ void UCILoop() {
       mb                      = Max(2, Min(HASH_MAX, mb));
       uint64_t bytesAllocated = TTInit(mb);
       uint64_t totalEntries   = BUCKET_SIZE * bytesAllocated / sizeof(TTBucket);
-      printf("info string set Hash to value %d (%" PRIu64 " bytes) (%" PRIu64 " entries)\n",
+      printf("info string set Hash to value %d (%" PRIu64 " bytes) (%" PRIu64 " entries) (%s)\n",
              mb,
              bytesAllocated,
-             totalEntries);
+             totalEntries,
+             PagesName(TT.pages));
     } else if (!strncmp(in, "setoption name Threads value ", 29)) {
       int n = GetOptionIntValue(in);
       ThreadsSetNumber(Max(1, Min(256, n)));
       printf("info string set Threads to value %d\n", Threads.count);
+    } else if (!strncmp(in, "setoption name LargePages value ", 32)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      LARGE_PAGES = !strncmp(opt, "true", 4);
+
+      // Reallocate everything that is backed by large pages
+      int n = Threads.count;
+      ThreadsSetNumber(0);
+      ThreadsSetNumber(n);
+      if (TT.mem)
+        TTInit(TT.size / MEGABYTE);
+
+      printf("info string set LargePages to value %s\n", LARGE_PAGES ? "true" : "false");
+      printf("info string Hash using %s, thread memory using %s\n",
+             PagesName(TT.pages),
+             PagesName(Threads.threads[0]->nnMemPages));
+    } else if (!strncmp(in, "setoption name NumaBind value ", 30)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      NUMA_BIND = !strncmp(opt, "true", 4);
+
+      // Rebuild the pool so every thread is pinned (or not) and re-allocated
+      int n = Threads.count;
+      ThreadsSetNumber(0);
+      ThreadsSetNumber(n);
+      printf("info string set NumaBind to value %s (%d nodes)\n", NUMA_BIND ? "true" : "false", NumaNodes());
+    } else if (!strncmp(in, "setoption name NumaHash value ", 30)) {
+      NUMA_HASH = !strncmp(in + 30, "interleave", 10) ? NUMA_HASH_INTERLEAVE : NUMA_HASH_FIRST_TOUCH;
+
+      // Reallocate so the new policy applies before the table is first touched
+      if (TT.mem)
+        TTInit(TT.size / MEGABYTE);
+      printf("info string set NumaHash to value %s\n", NUMA_HASH == NUMA_HASH_INTERLEAVE ? "interleave" : "firsttouch");
+    } else if (!strncmp(in, "setoption name HelperPolicy value ", 34)) {
+      HELPER_POLICY = !strncmp(in + 34, "skip", 4)     ? HELPER_POLICY_SKIP
+                      : !strncmp(in + 34, "window", 6) ? HELPER_POLICY_WINDOW
+                                                       : HELPER_POLICY_NONE;
+      printf("info string set HelperPolicy to value %s\n", HelperPolicyName());
+    } else if (!strncmp(in, "setoption name ABDADA value ", 28)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      ABDADA = !strncmp(opt, "true", 4);
+      printf("info string set ABDADA to value %s\n", ABDADA ? "true" : "false");
+    } else if (!strncmp(in, "setoption name WarmStart value ", 31)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      WARM_START = !strncmp(opt, "true", 4);
+      printf("info string set WarmStart to value %s\n", WARM_START ? "true" : "false");
+    } else if (!strncmp(in, "setoption name SharedCorrection value ", 38)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      SHARED_CORRECTION = !strncmp(opt, "true", 4);
+      printf("info string set SharedCorrection to value %s\n", SHARED_CORRECTION ? "true" : "false");
+    } else if (!strncmp(in, "setoption name SeedHelpers value ", 33)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      SEED_HELPERS = !strncmp(opt, "true", 4);
+      printf("info string set SeedHelpers to value %s\n", SEED_HELPERS ? "true" : "false");
+    } else if (!strncmp(in, "setoption name MultiPVSplit value ", 34)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      MULTIPV_SPLIT = !strncmp(opt, "true", 4);
+      printf("info string set MultiPVSplit to value %s\n", MULTIPV_SPLIT ? "true" : "false");
+    } else if (!strncmp(in, "setoption name PartialSort value ", 33)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      PARTIAL_SORT = !strncmp(opt, "true", 4);
+      printf("info string set PartialSort to value %s\n", PARTIAL_SORT ? "true" : "false");
+    } else if (!strncmp(in, "setoption name PerftHash value ", 31)) {
+      int n = GetOptionIntValue(in);
+
+      PERFT_HASH_MB = Max(0, Min(65536, n));
+      printf("info string set PerftHash to value %d\n", PERFT_HASH_MB);
+    } else if (!strncmp(in, "setoption name Trace value ", 27)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      TraceSet(!strncmp(opt, "true", 4));
+      printf("info string set Trace to value %s\n", TRACING ? "true" : "false");
     } else if (!strncmp(in, "setoption name SyzygyPath value ", 32)) {
-      int success = tb_init(in + 32);
-      if (success)
-        printf("info string set SyzygyPath to value %s\n", in + 32);
-      else
-        printf("info string FAILED!\n");
+      TBInit(in + 32);
+    } else if (!strncmp(in, "setoption name SyzygyProbeDepth value ", 38)) {
+      int n = GetOptionIntValue(in);
+
+      TB_PROBE_DEPTH = Max(1, Min(100, n));
+      printf("info string set SyzygyProbeDepth to value %d\n", TB_PROBE_DEPTH);
+    } else if (!strncmp(in, "setoption name SyzygyProbeLimit value ", 38)) {
+      int n = GetOptionIntValue(in);
+
+      TB_PROBE_LIMIT = Max(0, Min(7, n));
+      printf("info string set SyzygyProbeLimit to value %d\n", TB_PROBE_LIMIT);
+    } else if (!strncmp(in, "setoption name SyzygyPreload value ", 35)) {
+      int n = GetOptionIntValue(in);
+
+      TB_PRELOAD = Max(0, Min(7, n));
+      printf("info string set SyzygyPreload to value %d\n", TB_PRELOAD);
+      TBPreload();
+    } else if (!strncmp(in, "setoption name SyzygyLock value ", 32)) {
+      char opt[6];
+      sscanf(in, "%*s %*s %*s %*s %5s", opt);
+
+      TB_LOCK = !strncmp(opt, "true", 4);
+      printf("info string set SyzygyLock to value %s\n", TB_LOCK ? "true" : "false");
+      TBPreload();
     } else if (!strncmp(in, "setoption name MultiPV value ", 29)) {
       int n = GetOptionIntValue(in);
 
@@ -415,10 +703,14 @@ void UCILoop() {
       printf("info string Resetting board...\n");
 
       ParsePosition("position startpos\n", &board);
-      TTClear();
       SearchClear();
+      TTClear();
     } else if (!strncmp(in, "setoption name MoveOverhead value ", 34)) {
       MOVE_OVERHEAD = Min(10000, Max(0, GetOptionIntValue(in)));
+    } else if (!strncmp(in, "setoption name NodesTime value ", 31)) {
+      NODES_TIME       = Min(10000, Max(0, GetOptionIntValue(in)));
+      Limits.nodesLeft = 0;
+      printf("info string set NodesTime to value %d\n", NODES_TIME);
     } else if (!strncmp(in, "setoption name Contempt value ", 30)) {
       CONTEMPT = Min(100, Max(-100, GetOptionIntValue(in)));
     } else if (!strncmp(in, "setoption name EvalFile value ", 30)) {
@@ -426,7 +718,7 @@ void UCILoop() {
       int success = 0;
 
       if (strncmp(path, "<empty>", 7))
-        success = LoadNetwork(path);
+        success = LoadNetwork(&NETWORK, path);
       else {
         LoadDefaultNN();
         success = 1;
@@ -434,12 +726,24 @@ void UCILoop() {
 
       if (success)
         printf("info string set EvalFile to value %s\n", path);
+    } else if (!strncmp(in, "setoption name SmallEvalFile value ", 35)) {
+      char* path  = in + 35;
+      int success = 0;
+
+      if (strncmp(path, "<empty>", 7))
+        success = LoadNetwork(&SMALL_NETWORK, path);
+      else {
+        UnloadNetwork(&SMALL_NETWORK);
+        success = 1;
+      }
+
+      if (success)
+        printf("info string set SmallEvalFile to value %s\n", path);
     } else
       printf("Unknown command: %s \n", in);
   }
 
-  if (Threads.searching)
-    ThreadWaitUntilSleep(Threads.threads[0]);
+  WaitForSearch();
 
   pthread_mutex_destroy(&Threads.lock);
   ThreadsExit();
@@ -19,9 +19,12 @@
 
 #include "types.h"
 
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
 extern int SHOW_WDL;
 extern int CHESS_960;
 extern int CONTEMPT;
+extern int NODES_TIME;
 extern SearchParams Limits;
 
 // Normalization of a score to 50% WR at 100cp
@@ -32,6 +35,8 @@ int WRModel(Score s, int ply);
 void RootMoves(SimpleMoveList* moves, Board* board);
 
 void ParseGo(char* in, Board* board);
+void StopSearch();
+void WaitForSearch();
 void ParsePosition(char* in, Board* board);
 void PrintUCIOptions();
 
@@ -40,4 +45,17 @@ void UCILoop();
 
 int GetOptionIntValue(char* in);
 
+extern int STARTUP_PROFILE;
+
+// Times a startup phase for --startup-profile
+#define StartupPhase(name, call)                                                                                       \
+  do {                                                                                                                 \
+    uint64_t phaseStart = GetTimeUS();                                                                                 \
+    call;                                                                                                              \
+    PrintStartupPhase(name, phaseStart);                                                                               \
+  } while (0)
+
+void PrintStartupPhase(const char* name, uint64_t start);
+void FinishStartup();
+
 #endif
\ No newline at end of file
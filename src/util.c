@@ -14,8 +14,39 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+#include "util.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#endif
+
 #include "types.h"
 
+#define HUGE_2MB (2ull * 1024 * 1024)
+#define HUGE_1GB (1024ull * 1024 * 1024)
+
+int LARGE_PAGES = 0;
+
 #ifdef WIN32
 #include <windows.h>
 
@@ -23,9 +54,25 @@ long GetTimeMS() {
   return GetTickCount();
 }
 
+uint64_t GetTimeUS() {
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+
+  return count.QuadPart * 1000000 / frequency.QuadPart;
+}
+
+int OnlineCpus() {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  return info.dwNumberOfProcessors;
+}
+
 #else
 #include <stddef.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 long GetTimeMS() {
   struct timeval time;
@@ -34,4 +81,163 @@ long GetTimeMS() {
   return time.tv_sec * 1000 + time.tv_usec / 1000;
 }
 
+uint64_t GetTimeUS() {
+  struct timeval time;
+  gettimeofday(&time, NULL);
+
+  return (uint64_t) time.tv_sec * 1000000 + time.tv_usec;
+}
+
+int OnlineCpus() {
+  return Max(1, (int) sysconf(_SC_NPROCESSORS_ONLN));
+}
+
 #endif
+
+#if defined(__linux__)
+static uint64_t MapLength(uint64_t size, uint64_t pageSize) {
+  return (size + pageSize - 1) & ~(pageSize - 1);
+}
+
+static void* MapHugePages(uint64_t size, uint64_t pageSize, int flags) {
+  void* mem = mmap(NULL,
+                   MapLength(size, pageSize),
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flags,
+                   -1,
+                   0);
+
+  return mem == MAP_FAILED ? NULL : mem;
+}
+
+static void* MapSmall(uint64_t size) {
+  void* mem =
+    mmap(NULL, MapLength(size, sysconf(_SC_PAGESIZE)), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  return mem == MAP_FAILED ? NULL : mem;
+}
+
+// Anonymous mapping aligned to 2MB, trimming the excess on both sides
+static void* MapAligned(uint64_t size) {
+  const uint64_t length = MapLength(size, sysconf(_SC_PAGESIZE));
+
+  char* mem = mmap(NULL, length + HUGE_2MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return NULL;
+
+  char* aligned = (char*) (((uintptr_t) mem + HUGE_2MB - 1) & ~(HUGE_2MB - 1));
+  if (aligned > mem)
+    munmap(mem, aligned - mem);
+  if (aligned + length < mem + length + HUGE_2MB)
+    munmap(aligned + length, mem + HUGE_2MB - aligned);
+
+  return aligned;
+}
+
+enum { THP_NEVER, THP_MADVISE, THP_ALWAYS };
+
+// The transparent huge page mode of the kernel, never when it can't be read
+static int THPMode() {
+  char mode[128] = "";
+
+  FILE* fin = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+  if (fin) {
+    if (!fgets(mode, sizeof(mode), fin))
+      mode[0] = '\0';
+    fclose(fin);
+  }
+
+  return strstr(mode, "[always]") ? THP_ALWAYS : strstr(mode, "[madvise]") ? THP_MADVISE : THP_NEVER;
+}
+#endif
+
+// Allocate a large, long lived and zeroed buffer. With LARGE_PAGES this tries
+// explicit hugetlbfs pages (1GB, then 2MB) before falling back to a 2MB
+// aligned mapping advised for transparent huge pages, which only counts as
+// such when the kernel's THP mode allows it. Fresh mappings are
+// zeroed lazily by the kernel, so callers never need to clear them up front.
+// The kind of pages obtained is returned so the buffer can be released (and
+// reported) correctly.
+void* LargePagesAlloc(uint64_t size, int* pages) {
+#if defined(__linux__)
+  void* mem;
+
+  if (LARGE_PAGES) {
+    if (size >= HUGE_1GB && (mem = MapHugePages(size, HUGE_1GB, MAP_HUGE_1GB))) {
+      *pages = PAGES_HUGE_1GB;
+      return mem;
+    }
+
+    if ((mem = MapHugePages(size, HUGE_2MB, MAP_HUGE_2MB))) {
+      *pages = PAGES_HUGE_2MB;
+      return mem;
+    }
+  }
+
+  // Without room for the alignment slack a plain mapping may still fit
+  if (!(mem = MapAligned(size))) {
+    if (!(mem = MapSmall(size)))
+      printf("info string Unable to allocate %" PRIu64 " bytes\n", size), exit(1);
+
+    *pages = PAGES_SMALL;
+    return mem;
+  }
+
+  int advised = 0;
+#if defined(MADV_HUGEPAGE)
+  advised = !madvise(mem, size, MADV_HUGEPAGE);
+#endif
+
+  const int thp = THPMode();
+  *pages        = thp == THP_ALWAYS || (thp == THP_MADVISE && advised) ? PAGES_TRANSPARENT : PAGES_SMALL;
+
+  return mem;
+#else
+  // Both hand out pages the OS zeroes on first touch, like the mappings above
+#if defined(WIN32)
+  void* mem = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    mem = NULL;
+#endif
+  if (!mem)
+    printf("info string Unable to allocate %" PRIu64 " bytes\n", size), exit(1);
+
+  *pages = PAGES_SMALL;
+  return mem;
+#endif
+}
+
+void LargePagesFree(void* mem, uint64_t size, int pages) {
+  if (!mem)
+    return;
+
+#if defined(__linux__)
+  if (pages == PAGES_HUGE_1GB)
+    munmap(mem, MapLength(size, HUGE_1GB));
+  else if (pages == PAGES_HUGE_2MB)
+    munmap(mem, MapLength(size, HUGE_2MB));
+  else
+    munmap(mem, MapLength(size, sysconf(_SC_PAGESIZE)));
+#elif defined(WIN32)
+  (void) size;
+  (void) pages;
+
+  VirtualFree(mem, 0, MEM_RELEASE);
+#else
+  (void) pages;
+
+  munmap(mem, size);
+#endif
+}
+
+const char* PagesName(int pages) {
+  switch (pages) {
+    case PAGES_HUGE_1GB: return "1GB huge pages";
+    case PAGES_HUGE_2MB: return "2MB huge pages";
+    case PAGES_TRANSPARENT: return "transparent huge pages";
+    case PAGES_FILE: return "a file mapping";
+    default: return "4KB pages";
+  }
+}
@@ -29,8 +29,26 @@
 
 #define LoadRlx(x) atomic_load_explicit(&(x), memory_order_relaxed)
 #define IncRlx(x)  atomic_fetch_add_explicit(&(x), 1, memory_order_relaxed)
+// single writer counters need no locked add, an untorn store is enough
+#define IncOwned(x) atomic_store_explicit(&(x), LoadRlx(x) + 1, memory_order_relaxed)
+
+enum {
+  PAGES_SMALL,
+  PAGES_TRANSPARENT,
+  PAGES_HUGE_2MB,
+  PAGES_HUGE_1GB,
+  PAGES_FILE
+};
+
+extern int LARGE_PAGES;
 
 long GetTimeMS();
+uint64_t GetTimeUS();
+int OnlineCpus();
+
+void* LargePagesAlloc(uint64_t size, int* pages);
+void LargePagesFree(void* mem, uint64_t size, int pages);
+const char* PagesName(int pages);
 
 INLINE void* AlignedMalloc(uint64_t size, const size_t on) {
   void* mem  = malloc(size + on + sizeof(void*));